@@ -458,6 +458,9 @@ void mutt_alias_add_reverse (ALIAS *t)
   if (!t)
     return;
 
+  IndexRowGen++;
+  ColorIndexGen++;
+
   /* Note that the address mailbox should be converted to intl form
    * before using as a key in the hash.  This is currently done
    * by all callers, but added here mostly as documentation.. */
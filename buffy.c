@@ -42,7 +42,9 @@
 #endif
 
 #include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <dirent.h>
 #include <utime.h>
 #include <ctype.h>
@@ -349,33 +351,93 @@ int mutt_parse_mailboxes (BUFFER *path, BUFFER *s, union pointer_long_t udata, B
   return 0;
 }
 
+/* Is what buffy_maildir_check_dir() found in the directory last time
+ * still good? */
+static int buffy_maildir_dir_unchanged (BUFFY *mailbox, BUFFY_DIR *cache,
+                                        struct stat *sb)
+{
+  return cache->valid &&
+         !mutt_stat_timespec_compare (sb, MUTT_STAT_MTIME, &cache->mtime) &&
+         !mutt_timespec_compare (&mailbox->last_visited, &cache->last_visited) &&
+         (cache->recent == (option (OPTMAILCHECKRECENT) ? 1 : 0));
+}
+
 /* Checks the specified maildir subdir (cur or new) for new mail or mail counts.
  * check_new:   if true, check for new mail.
  * check_stats: if true, count total, new, and flagged messages.
  * Returns 1 if the dir has new mail.
+ *
+ * The directory is only read again when its mtime changed, or when the last
+ * read didn't determine what is asked for now.
  */
 static int buffy_maildir_check_dir (BUFFY* mailbox, const char *dir_name, int check_new,
                                     int check_stats)
 {
   BUFFER *path = NULL;
   BUFFER *msgpath = NULL;
+  BUFFY_DIR *cache;
   DIR *dirp;
   struct dirent *de;
   char *p;
   int rc = 0;
-  struct stat sb;
+  int orig_check_new = check_new;
+  int have_stat = 0;
+  int keep_stats = 0;
+  int moved = 0;
+  int msg_count = 0, msg_unread = 0, msg_flagged = 0;
+  time_t now;
+  struct stat sb, dir_sb;
 
   path = mutt_buffer_pool_get ();
   msgpath = mutt_buffer_pool_get ();
   mutt_buffer_printf (path, "%s/%s", mutt_b2s (mailbox->pathbuf), dir_name);
 
+  cache = mutt_strcmp (dir_name, "new") ? &mailbox->maildir_cur : &mailbox->maildir_new;
+
+  now = time (NULL);
+  if (stat (mutt_b2s (path), &dir_sb) == 0)
+    have_stat = 1;
+
+  if (!have_stat)
+    cache->valid = 0;
+  else if (buffy_maildir_dir_unchanged (mailbox, cache, &dir_sb))
+  {
+    if ((!check_stats || cache->stats) &&
+        (!check_new || cache->checked_new))
+    {
+      if (check_stats)
+      {
+        mailbox->msg_count   += cache->msg_count;
+        mailbox->msg_unread  += cache->msg_unread;
+        mailbox->msg_flagged += cache->msg_flagged;
+      }
+      if (check_new && cache->has_new)
+      {
+        mailbox->new = 1;
+        rc = 1;
+      }
+      goto cleanup;
+    }
+
+    /* the counts can be kept while only looking for new mail */
+    if ((keep_stats = cache->stats) && check_stats)
+    {
+      mailbox->msg_count   += cache->msg_count;
+      mailbox->msg_unread  += cache->msg_unread;
+      mailbox->msg_flagged += cache->msg_flagged;
+      check_stats = 0;
+    }
+  }
+  else
+    cache->valid = 0;
+
   /* when $mail_check_recent is set, if the new/ directory hasn't been modified since
    * the user last exited the mailbox, then we know there is no recent mail.
    */
   if (check_new && option(OPTMAILCHECKRECENT))
   {
-    if (stat(mutt_b2s (path), &sb) == 0 &&
-        mutt_stat_timespec_compare (&sb, MUTT_STAT_MTIME, &mailbox->last_visited) < 0)
+    if (have_stat &&
+        mutt_stat_timespec_compare (&dir_sb, MUTT_STAT_MTIME, &mailbox->last_visited) < 0)
     {
       rc = 0;
       check_new = 0;
@@ -383,11 +445,12 @@ static int buffy_maildir_check_dir (BUFFY* mailbox, const char *dir_name, int ch
   }
 
   if (! (check_new || check_stats))
-    goto cleanup;
+    goto remember;
 
   if ((dirp = opendir (mutt_b2s (path))) == NULL)
   {
     mailbox->magic = 0;
+    cache->valid = 0;
     rc = 0;
     goto cleanup;
   }
@@ -403,14 +466,14 @@ static int buffy_maildir_check_dir (BUFFY* mailbox, const char *dir_name, int ch
 
     if (check_stats)
     {
-      mailbox->msg_count++;
+      msg_count++;
       if (p && strchr (p + 3, 'F'))
-        mailbox->msg_flagged++;
+        msg_flagged++;
     }
     if (!p || !strchr (p + 3, 'S'))
     {
       if (check_stats)
-        mailbox->msg_unread++;
+        msg_unread++;
       if (check_new)
       {
         if (option(OPTMAILCHECKRECENT))
@@ -432,6 +495,47 @@ static int buffy_maildir_check_dir (BUFFY* mailbox, const char *dir_name, int ch
 
   closedir (dirp);
 
+  /* The monitor may report a change made during the read, which the
+   * read might have counted already.  Only remember a read that nothing
+   * interfered with. */
+  if (have_stat &&
+      (stat (mutt_b2s (path), &sb) != 0 ||
+       mutt_stat_compare (&sb, MUTT_STAT_MTIME, &dir_sb, MUTT_STAT_MTIME)))
+    moved = 1;
+
+  if (check_stats)
+  {
+    mailbox->msg_count   += msg_count;
+    mailbox->msg_unread  += msg_unread;
+    mailbox->msg_flagged += msg_flagged;
+  }
+
+remember:
+  if (have_stat)
+  {
+    if (keep_stats)
+    {
+      msg_count   = cache->msg_count;
+      msg_unread  = cache->msg_unread;
+      msg_flagged = cache->msg_flagged;
+    }
+
+    mutt_get_stat_timespec (&cache->mtime, &dir_sb, MUTT_STAT_MTIME);
+    cache->last_visited = mailbox->last_visited;
+    cache->recent = option (OPTMAILCHECKRECENT) ? 1 : 0;
+    cache->msg_count   = msg_count;
+    cache->msg_unread  = msg_unread;
+    cache->msg_flagged = msg_flagged;
+    cache->stats = (check_stats || keep_stats) ? 1 : 0;
+    cache->checked_new = orig_check_new ? 1 : 0;
+    cache->has_new = rc ? 1 : 0;
+
+    /* A change within the same second as the read may not show in a
+     * coarse mtime, so such a read can't be trusted later on. */
+    cache->valid = (!moved && dir_sb.st_mtime < now) ? 1 : 0;
+    cache->settled = cache->valid;
+  }
+
 cleanup:
   mutt_buffer_pool_release (&path);
   mutt_buffer_pool_release (&msgpath);
@@ -439,6 +543,97 @@ cleanup:
   return rc;
 }
 
+#ifdef USE_INOTIFY
+/* Applies a change the monitor saw in a maildir subdirectory to what
+ * buffy_maildir_check_dir() last found there, so that the directory
+ * needn't be read again.
+ * name:  the message file that appeared or went away.
+ * added: true if it appeared.
+ */
+void mutt_buffy_maildir_changed (BUFFY *mailbox, int cur, const char *name, int added)
+{
+  BUFFY_DIR *cache = cur ? &mailbox->maildir_cur : &mailbox->maildir_new;
+  BUFFER *path = NULL;
+  struct stat sb;
+  const char *p;
+  int delta = added ? 1 : -1;
+  int unread, flagged;
+
+  /* nothing known to update: the next check reads the directory */
+  if (!cache->valid)
+    return;
+
+  path = mutt_buffer_pool_get ();
+  mutt_buffer_printf (path, "%s/%s", mutt_b2s (mailbox->pathbuf), cur ? "cur" : "new");
+  if (stat (mutt_b2s (path), &sb) != 0)
+  {
+    cache->valid = 0;
+    goto cleanup;
+  }
+  /* The directory's mtime now includes this change.  Changes made since
+   * are already queued, and will be applied in turn. */
+  mutt_get_stat_timespec (&cache->mtime, &sb, MUTT_STAT_MTIME);
+  /* a change still queued may share a coarse mtime: not worth saving */
+  cache->settled = (sb.st_mtime < time (NULL)) ? 1 : 0;
+
+  /* count it the same way buffy_maildir_check_dir() does */
+  if (*name == '.')
+    goto cleanup;
+  p = strstr (name, ":2,");
+  if (p && strchr (p + 3, 'T'))
+    goto cleanup;
+  flagged = p && strchr (p + 3, 'F');
+  unread = !p || !strchr (p + 3, 'S');
+
+  if (cache->stats)
+  {
+    cache->msg_count += delta;
+    if (flagged)
+      cache->msg_flagged += delta;
+    if (unread)
+      cache->msg_unread += delta;
+
+    /* The BUFFY's counts are the sum of both caches, as of the last
+     * check with stats.  The open mailbox's are set from the Context. */
+    if (option (OPTMAILCHECKSTATS) &&
+        !(Context && !mutt_strcmp (mailbox->realpath, Context->realpath)))
+    {
+      mailbox->msg_count += delta;
+      if (flagged)
+        mailbox->msg_flagged += delta;
+      if (unread)
+        mailbox->msg_unread += delta;
+#ifdef USE_SIDEBAR
+      mutt_set_current_menu_redraw (REDRAW_SIDEBAR);
+#endif
+    }
+  }
+
+  if (unread && cache->checked_new)
+  {
+    if (added)
+      cache->has_new = 1;
+    else if (cache->has_new)
+      cache->checked_new = 0;	/* may have been the only one */
+  }
+
+cleanup:
+  mutt_buffer_pool_release (&path);
+}
+
+/* The monitor lost events: everything has to be read again. */
+void mutt_buffy_maildir_reset (void)
+{
+  BUFFY *tmp;
+
+  for (tmp = Incoming; tmp; tmp = tmp->next)
+  {
+    tmp->maildir_new.valid = 0;
+    tmp->maildir_cur.valid = 0;
+  }
+}
+#endif
+
 /* Checks new mail for a maildir mailbox.
  * check_stats: if true, also count total, new, and flagged messages.
  * Returns 1 if the mailbox has new mail.
@@ -519,6 +714,17 @@ static int buffy_mbox_check (BUFFY* mailbox, struct stat *sb, int check_stats)
   return rc;
 }
 
+#ifdef DEBUG
+static long buffy_elapsed_ms (struct timeval *since)
+{
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  return (now.tv_sec - since->tv_sec) * 1000L +
+         (now.tv_usec - since->tv_usec) / 1000;
+}
+#endif
+
 /* Check all Incoming for new mail and total/new/flagged messages
  * The force argument may be any combination of the following values:
  *   MUTT_BUFFY_CHECK_FORCE        ignore BuffyTimeout and check for new mail
@@ -535,6 +741,12 @@ int mutt_buffy_check (int force)
   short orig_new;
   int orig_count, orig_unread, orig_flagged;
 #endif
+#ifdef DEBUG
+  struct timeval check_start, poll_start;
+  long poll_ms, slowest_ms = -1;
+  const char *slowest = NULL;
+  int polled = 0;
+#endif
 
   sb.st_size=0;
   contex_sb.st_dev=0;
@@ -565,6 +777,16 @@ int mutt_buffy_check (int force)
   BuffyCount = 0;
   BuffyNotify = 0;
 
+#ifdef USE_INOTIFY
+  /* Changes still queued are applied to the maildir caches first.  A
+   * directory read below already includes them. */
+  mutt_monitor_drain ();
+#endif
+
+#ifdef DEBUG
+  gettimeofday (&check_start, NULL);
+#endif
+
 #ifdef USE_IMAP
   BuffyCount += imap_buffy_check (force, check_stats);
 #endif
@@ -615,6 +837,10 @@ int mutt_buffy_check (int force)
             ? mutt_strcmp (mutt_b2s (tmp->pathbuf), Context->path) :
 	      (sb.st_dev != contex_sb.st_dev || sb.st_ino != contex_sb.st_ino)))
     {
+#ifdef DEBUG
+      gettimeofday (&poll_start, NULL);
+#endif
+
       switch (tmp->magic)
       {
         case MUTT_MBOX:
@@ -633,6 +859,15 @@ int mutt_buffy_check (int force)
             BuffyCount++;
           break;
       }
+
+#ifdef DEBUG
+      polled++;
+      if ((poll_ms = buffy_elapsed_ms (&poll_start)) > slowest_ms)
+      {
+        slowest_ms = poll_ms;
+        slowest = mutt_b2s (tmp->pathbuf);
+      }
+#endif
     }
     else if (option(OPTCHECKMBOXSIZE) && Context && Context->path)
       tmp->size = (off_t) sb.st_size;	/* update the size of current folder */
@@ -651,10 +886,229 @@ int mutt_buffy_check (int force)
       BuffyNotify++;
   }
 
+  dprint (2, (debugfile, "mutt_buffy_check: polled %d mailboxes%s in %ld ms, slowest %s (%ld ms)\n",
+              polled, check_stats ? " with stats" : "",
+              buffy_elapsed_ms (&check_start), NONULL (slowest), slowest_ms));
+
   BuffyDoneTime = BuffyTime;
   return (BuffyCount);
 }
 
+#define BUFFY_STATS_VERSION "mutt buffy stats 1"
+
+/* The counts of a maildir subdirectory as stored by mutt_buffy_save_stats() */
+static int buffy_parse_stats_dir (const char *s, BUFFY_DIR *cache, int *n)
+{
+  long long sec;
+  long nsec;
+
+  if (sscanf (s, " %lld %ld %d %d %d%n", &sec, &nsec, &cache->msg_count,
+              &cache->msg_unread, &cache->msg_flagged, n) != 5)
+    return -1;
+
+  cache->mtime.tv_sec = (time_t) sec;
+  cache->mtime.tv_nsec = nsec;
+  return 0;
+}
+
+/* Seeds Incoming with the counts mutt_buffy_save_stats() stored at the end
+ * of the last session.  Along with the counts, the mtimes they were taken
+ * at are restored, so the first $mail_check_stats only reads the mailboxes
+ * which changed since.  IMAP counts are only shown until the first STATUS
+ * reply replaces them.
+ */
+void mutt_buffy_load_stats (void)
+{
+  FILE *fp;
+  HASH *incoming;
+  BUFFY *tmp;
+  BUFFY_DIR new_dir, cur_dir;
+  char *line = NULL, *path;
+  size_t linelen = 0;
+  int lineno = 0, loaded = 0, n, n2;
+  int magic, msg_count, msg_unread, msg_flagged;
+  long long sec;
+  long nsec;
+
+  if (!MailCheckStatsCache || !Incoming)
+    return;
+
+  if ((fp = fopen (MailCheckStatsCache, "r")) == NULL)
+    return;
+
+  if ((line = mutt_read_line (line, &linelen, fp, &lineno, 0)) == NULL ||
+      mutt_strcmp (line, BUFFY_STATS_VERSION))
+  {
+    dprint (1, (debugfile, "mutt_buffy_load_stats: ignoring %s: unknown version\n",
+                MailCheckStatsCache));
+    goto cleanup;
+  }
+
+  incoming = hash_create (64, MUTT_HASH_STRDUP_KEYS);
+  for (tmp = Incoming; tmp; tmp = tmp->next)
+    hash_insert (incoming, mutt_b2s (tmp->pathbuf), tmp);
+
+  while ((line = mutt_read_line (line, &linelen, fp, &lineno, 0)) != NULL)
+  {
+    if ((path = strchr (line, '\t')) == NULL)
+      continue;
+    *path++ = '\0';
+
+    if ((tmp = hash_find (incoming, path)) == NULL)
+      continue;
+
+    if (sscanf (line, "%d %d %d %d%n", &magic, &msg_count, &msg_unread,
+                &msg_flagged, &n) != 4)
+      continue;
+    if (tmp->magic && (tmp->magic != magic))
+      continue;
+
+    switch (magic)
+    {
+      case MUTT_MBOX:
+      case MUTT_MMDF:
+      case MUTT_MH:
+        if (sscanf (line + n, " %lld %ld", &sec, &nsec) != 2)
+          continue;
+        tmp->stats_last_checked.tv_sec = (time_t) sec;
+        tmp->stats_last_checked.tv_nsec = nsec;
+        break;
+
+      case MUTT_MAILDIR:
+        memset (&new_dir, 0, sizeof (new_dir));
+        memset (&cur_dir, 0, sizeof (cur_dir));
+        if (buffy_parse_stats_dir (line + n, &new_dir, &n2) ||
+            buffy_parse_stats_dir (line + n + n2, &cur_dir, &n2))
+          continue;
+        new_dir.last_visited = cur_dir.last_visited = tmp->last_visited;
+        new_dir.recent = cur_dir.recent = option (OPTMAILCHECKRECENT) ? 1 : 0;
+        new_dir.stats = cur_dir.stats = 1;
+        new_dir.valid = cur_dir.valid = 1;
+        new_dir.settled = cur_dir.settled = 1;
+        tmp->maildir_new = new_dir;
+        tmp->maildir_cur = cur_dir;
+        break;
+
+#ifdef USE_IMAP
+      case MUTT_IMAP:
+        break;
+#endif
+
+      default:
+        continue;
+    }
+
+    tmp->msg_count = msg_count;
+    tmp->msg_unread = msg_unread;
+    tmp->msg_flagged = msg_flagged;
+    loaded++;
+  }
+
+  hash_destroy (&incoming, NULL);
+  dprint (2, (debugfile, "mutt_buffy_load_stats: %d mailboxes from %s\n",
+              loaded, MailCheckStatsCache));
+
+cleanup:
+  FREE (&line);
+  safe_fclose (&fp);
+}
+
+static void buffy_save_stats_dir (FILE *fp, BUFFY_DIR *cache)
+{
+  fprintf (fp, " %lld %ld %d %d %d", (long long) cache->mtime.tv_sec,
+           (long) cache->mtime.tv_nsec, cache->msg_count,
+           cache->msg_unread, cache->msg_flagged);
+}
+
+/* Stores the counts of Incoming along with what they were taken from,
+ * for mutt_buffy_load_stats() to pick up at the next startup.  Mailboxes
+ * whose counts aren't known to be current are left out.
+ */
+void mutt_buffy_save_stats (void)
+{
+  FILE *fp;
+  BUFFY *tmp;
+  BUFFER *tmpfname = NULL;
+  int saved = 0;
+
+  if (!MailCheckStatsCache || !Incoming)
+    return;
+
+  tmpfname = mutt_buffer_pool_get ();
+  mutt_buffer_printf (tmpfname, "%s.%d", MailCheckStatsCache, (int) getpid ());
+  unlink (mutt_b2s (tmpfname));
+  if ((fp = safe_fopen (mutt_b2s (tmpfname), "w")) == NULL)
+  {
+    dprint (1, (debugfile, "mutt_buffy_save_stats: can't create %s\n",
+                mutt_b2s (tmpfname)));
+    goto cleanup;
+  }
+
+  fprintf (fp, "%s\n", BUFFY_STATS_VERSION);
+  for (tmp = Incoming; tmp; tmp = tmp->next)
+  {
+    /* the tab separates the path, which may contain anything else */
+    if (strchr (mutt_b2s (tmp->pathbuf), '\n'))
+      continue;
+
+    switch (tmp->magic)
+    {
+      case MUTT_MBOX:
+      case MUTT_MMDF:
+      case MUTT_MH:
+        if (!tmp->stats_last_checked.tv_sec)
+          continue;
+        fprintf (fp, "%d %d %d %d %lld %ld", tmp->magic, tmp->msg_count,
+                 tmp->msg_unread, tmp->msg_flagged,
+                 (long long) tmp->stats_last_checked.tv_sec,
+                 (long) tmp->stats_last_checked.tv_nsec);
+        break;
+
+      case MUTT_MAILDIR:
+        if (!(tmp->maildir_new.valid && tmp->maildir_new.settled &&
+              tmp->maildir_new.stats &&
+              tmp->maildir_cur.valid && tmp->maildir_cur.settled &&
+              tmp->maildir_cur.stats))
+          continue;
+        fprintf (fp, "%d %d %d %d", tmp->magic,
+                 tmp->maildir_new.msg_count + tmp->maildir_cur.msg_count,
+                 tmp->maildir_new.msg_unread + tmp->maildir_cur.msg_unread,
+                 tmp->maildir_new.msg_flagged + tmp->maildir_cur.msg_flagged);
+        buffy_save_stats_dir (fp, &tmp->maildir_new);
+        buffy_save_stats_dir (fp, &tmp->maildir_cur);
+        break;
+
+#ifdef USE_IMAP
+      case MUTT_IMAP:
+        fprintf (fp, "%d %d %d %d", tmp->magic, tmp->msg_count,
+                 tmp->msg_unread, tmp->msg_flagged);
+        break;
+#endif
+
+      default:
+        continue;
+    }
+
+    fprintf (fp, "\t%s\n", mutt_b2s (tmp->pathbuf));
+    saved++;
+  }
+
+  if (safe_fclose (&fp) != 0 ||
+      rename (mutt_b2s (tmpfname), MailCheckStatsCache) != 0)
+  {
+    dprint (1, (debugfile, "mutt_buffy_save_stats: can't write %s: %s\n",
+                MailCheckStatsCache, strerror (errno)));
+    unlink (mutt_b2s (tmpfname));
+    goto cleanup;
+  }
+
+  dprint (2, (debugfile, "mutt_buffy_save_stats: %d mailboxes to %s\n",
+              saved, MailCheckStatsCache));
+
+cleanup:
+  mutt_buffer_pool_release (&tmpfname);
+}
+
 int mutt_buffy_list (void)
 {
   BUFFY *tmp;
@@ -23,6 +23,24 @@
 #define MUTT_MAILBOXES   1
 #define MUTT_UNMAILBOXES 2
 
+/* what the last read of a maildir subdirectory found, so it needn't be
+ * read again while the directory is unchanged */
+typedef struct
+{
+  struct timespec mtime;	/* of the directory when it was read */
+  struct timespec last_visited;	/* of the BUFFY at the time */
+  int msg_count;
+  int msg_unread;
+  int msg_flagged;
+  unsigned int valid : 1;
+  unsigned int stats : 1;	/* the counts were taken */
+  unsigned int checked_new : 1;	/* has_new was determined */
+  unsigned int has_new : 1;
+  unsigned int recent : 1;	/* $mail_check_recent at the time */
+  unsigned int settled : 1;	/* no later change can share the mtime */
+}
+BUFFY_DIR;
+
 typedef struct buffy_t
 {
   BUFFER *pathbuf;
@@ -42,6 +60,8 @@ typedef struct buffy_t
   short newly_created;		/* mbox or mmdf just popped into existence */
   struct timespec last_visited;		/* time of last exit from this mailbox */
   struct timespec stats_last_checked;	/* mtime of mailbox the last time stats where checked. */
+  BUFFY_DIR maildir_new;	/* maildir new/ and cur/ */
+  BUFFY_DIR maildir_cur;
 }
 BUFFY;
 
@@ -68,8 +88,18 @@ void mutt_buffy_cleanup (const char *buf, struct stat *st);
 /* mark mailbox just left as already notified */
 void mutt_buffy_setnotified (const char *path);
 
+/* $mail_check_stats_cache */
+void mutt_buffy_load_stats (void);
+void mutt_buffy_save_stats (void);
+
 int mh_buffy (BUFFY *, int);
 
+#ifdef USE_INOTIFY
+/* maildir changes seen by the monitor */
+void mutt_buffy_maildir_changed (BUFFY *, int, const char *, int);
+void mutt_buffy_maildir_reset (void);
+#endif
+
 /* force flags passed to mutt_buffy_check() */
 #define MUTT_BUFFY_CHECK_FORCE       1
 #define MUTT_BUFFY_CHECK_FORCE_STATS (1<<1)
@@ -149,9 +149,108 @@ static void mutt_free_color_line(COLOR_LINE **l,
   regfree(&tmp->rx);
   mutt_pattern_free(&tmp->color_pattern);
   FREE (&tmp->pattern);
+  FREE (&tmp->literal);
   FREE (l);		/* __FREE_CHECKED__ */
 }
 
+/* Looks for the longest run of ASCII text that every match of the
+ * extended regexp s must contain, and for anything that makes a match
+ * depend on the text before where regexec() starts.  Anything unusual
+ * just means no literal. */
+static void analyze_regex (COLOR_LINE *tmp, const char *s, int icase)
+{
+  const char *p, *run = NULL, *best = NULL;
+  size_t len = 0, bestlen = 0;
+  int depth = 0, simple = 1;
+
+  tmp->icase = icase ? 1 : 0;
+  tmp->context_free = 1;
+
+  for (p = s; *p; p++)
+  {
+    if (*p == '^' && !(p > s && p[-1] == '['))
+      tmp->context_free = 0;
+    else if (*p == '\\' && p[1] && strchr ("<>bB`'", p[1]))
+      tmp->context_free = 0;
+  }
+
+  for (p = s; ; p++)
+  {
+    if (!depth && *p && ((unsigned char) *p) < 0x80 &&
+        isprint ((unsigned char) *p) && !strchr ("\\.[]()*+?{}|^$", *p))
+    {
+      if (!run)
+      {
+        run = p;
+        len = 0;
+      }
+      len++;
+      continue;
+    }
+
+    if (*p == '|')
+    {
+      /* alternatives have nothing in common we could rely on */
+      best = NULL;
+      break;
+    }
+
+    /* a quantifier makes the preceding character optional */
+    if (run && (*p == '*' || *p == '?' || *p == '{'))
+      len--;
+    if (run && len > bestlen)
+    {
+      best = run;
+      bestlen = len;
+    }
+    run = NULL;
+
+    if (!*p)
+      break;
+    simple = 0;
+
+    if (*p == '\\')
+    {
+      if (!*++p)
+        break;
+    }
+    else if (*p == '[')
+    {
+      /* skip the bracket expression, including [:class:] and friends */
+      if (*++p == '^')
+        p++;
+      if (*p == ']')
+        p++;
+      while (*p && *p != ']')
+      {
+        if (*p == '[' && p[1] && strchr (":.=", p[1]))
+        {
+          char close = p[1];
+
+          for (p += 2; *p && !(*p == close && p[1] == ']'); p++)
+            ;
+          if (!*p)
+            break;
+          p++;
+        }
+        p++;
+      }
+      if (!*p)
+        break;
+    }
+    else if (*p == '(')
+      depth++;
+    else if (*p == ')' && depth)
+      depth--;
+  }
+
+  if (best && bestlen)
+  {
+    tmp->literal = mutt_substrdup (best, best + bestlen);
+    tmp->is_literal = simple;
+  }
+}
+
 void ci_start_color (void)
 {
   memset (ColorDefs, A_NORMAL, sizeof (int) * MT_COLOR_MAX);
@@ -520,6 +619,9 @@ static int _mutt_parse_uncolor (BUFFER *buf, BUFFER *s, BUFFER *err, short parse
   while (MoreArgs (s));
 
 
+  if (!is_index && do_cache)
+    ColorBodyGen++;
+
   if (is_index && do_cache && !option (OPTNOCURSES))
   {
     int i;
@@ -595,6 +697,7 @@ add_pattern (COLOR_LINE **top, const char *s, int sensitive,
 	mutt_free_color_line(&tmp, 1);
 	return -1;
       }
+      tmp->stable = mutt_pattern_is_stable (tmp->color_pattern);
     }
     else if ((r = REGCOMP (&tmp->rx, s, (sensitive ? mutt_which_case (s) : REG_ICASE))) != 0)
     {
@@ -602,6 +705,8 @@ add_pattern (COLOR_LINE **top, const char *s, int sensitive,
       mutt_free_color_line(&tmp, 1);
       return (-1);
     }
+    else
+      analyze_regex (tmp, s, sensitive ? mutt_which_case (s) : REG_ICASE);
     tmp->next = *top;
     tmp->pattern = safe_strdup (s);
 #ifdef HAVE_COLOR
@@ -836,9 +941,15 @@ _mutt_parse_color (BUFFER *buf, BUFFER *s, BUFFER *err,
 #endif
 
   if (object == MT_COLOR_HEADER)
+  {
     r = add_pattern (&ColorHdrList, buf->data, 0, fg, bg, attr, err,0);
+    ColorBodyGen++;
+  }
   else if (object == MT_COLOR_BODY)
+  {
     r = add_pattern (&ColorBodyList, buf->data, 1, fg, bg, attr, err, 0);
+    ColorBodyGen++;
+  }
   else if (object == MT_COLOR_INDEX)
   {
     r = add_pattern (&ColorIndexList, buf->data, 1, fg, bg, attr, err, 1);
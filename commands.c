@@ -33,12 +33,14 @@
 #include "pager.h"
 #include "mutt_crypt.h"
 #include "mutt_idna.h"
+#include "md5.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 #ifdef USE_IMAP
 #include "imap.h"
+#include "imap_private.h"
 #endif
 
 #ifdef USE_AUTOCRYPT
@@ -55,6 +57,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <utime.h>
+#include <dirent.h>
 
 static const char *ExtPagerProgress = "all";
 
@@ -129,6 +132,8 @@ static void process_protected_headers (HEADER *cur)
 
     if (Context->subj_hash)
       hash_insert (Context->subj_hash, cur->env->real_subj, cur);
+    cur->gen++;
+    Context->gen++;
 
     mx_save_to_header_cache (Context, cur);
 
@@ -152,63 +157,254 @@ static void process_protected_headers (HEADER *cur)
 #endif
 }
 
-int mutt_display_message (HEADER *cur)
+/* Rendered message cache ($render_cachedir).  The pager input built by
+ * mutt_display_message() is kept there, named after a digest of the
+ * message and of the current settings, so that showing the message
+ * again doesn't repeat the decoding, $auto_view and $display_filter.
+ */
+
+/* Never store anything that went through signature checking or
+ * decryption. */
+static int render_cache_allowed (BODY *b)
 {
-  BUFFER *tempfile = NULL;
-  int rc = 0, builtin = 0;
-  int cmflags = MUTT_CM_DECODE | MUTT_CM_DISPLAY | MUTT_CM_CHARCONV;
-  FILE *fpout = NULL;
-  FILE *fpfilterout = NULL;
-  pid_t filterpid = -1;
-  int res;
+  for (; b; b = b->next)
+  {
+    if (mutt_is_multipart_encrypted (b) || mutt_is_multipart_signed (b) ||
+        mutt_is_application_pgp (b) || mutt_is_application_smime (b))
+      return 0;
+    if (b->parts && !render_cache_allowed (b->parts))
+      return 0;
+  }
+  return 1;
+}
 
-  mutt_parse_mime_message (Context, cur);
-  mutt_message_hook (Context, cur, MUTT_MESSAGEHOOK);
+static void render_cache_path (BUFFER *path, HEADER *cur, int cmflags,
+                               int chflags)
+{
+  struct md5_ctx ctx;
+  unsigned char digest[16];
+  const char *p;
+  int i, cols = MuttIndexWindow->cols;
+
+  mutt_config_digest (digest);
+
+  md5_init_ctx (&ctx);
+  md5_process_bytes (digest, sizeof (digest), &ctx);
+  md5_process_bytes (&cmflags, sizeof (cmflags), &ctx);
+  md5_process_bytes (&chflags, sizeof (chflags), &ctx);
+  /* format=flowed is wrapped for the current width */
+  md5_process_bytes (&cols, sizeof (cols), &ctx);
+
+  md5_process_bytes (Context->path, mutt_strlen (Context->path) + 1, &ctx);
+  if (cur->path)
+  {
+    /* skip the maildir flags, they change but the message doesn't */
+    p = strrchr (cur->path, '/');
+    p = p ? p + 1 : cur->path;
+    md5_process_bytes (p, strcspn (p, ":"), &ctx);
+  }
+  md5_process_bytes ("", 1, &ctx);
+  /* remote messages have no path, and their offsets don't tell them apart */
+#ifdef USE_IMAP
+  if (Context->magic == MUTT_IMAP)
+  {
+    md5_process_bytes (&((IMAP_DATA *) Context->data)->uid_validity,
+                       sizeof (unsigned int), &ctx);
+    md5_process_bytes (&HEADER_DATA (cur)->uid, sizeof (unsigned int), &ctx);
+  }
+#endif
+#ifdef USE_POP
+  if (Context->magic == MUTT_POP)
+    md5_process_bytes (NONULL ((char *) cur->data),
+                       mutt_strlen ((char *) cur->data) + 1, &ctx);
+#endif
+  md5_process_bytes (NONULL (cur->env->message_id),
+                     mutt_strlen (cur->env->message_id) + 1, &ctx);
+  md5_process_bytes (&cur->date_sent, sizeof (cur->date_sent), &ctx);
+  md5_process_bytes (&cur->received, sizeof (cur->received), &ctx);
+  md5_process_bytes (&cur->offset, sizeof (cur->offset), &ctx);
+  md5_process_bytes (&cur->content->offset, sizeof (cur->content->offset), &ctx);
+  md5_process_bytes (&cur->content->length, sizeof (cur->content->length), &ctx);
+  md5_finish_ctx (&ctx, digest);
+
+  mutt_buffer_printf (path, "%s/", RenderCachedir);
+  for (i = 0; i < 16; i++)
+    mutt_buffer_add_printf (path, "%02x", digest[i]);
+}
 
-  /* see if crypto is needed for this message.  if so, we should exit curses */
-  if (WithCrypto && cur->security)
+/* Puts a copy of the cache entry at tempfile.  Returns 0 on success. */
+static int render_cache_fetch (const char *cachefile, const char *tempfile)
+{
+  FILE *fpin, *fpout;
+  int rc;
+
+  /* the pager removes its input file, so a link is all it needs */
+  if (link (cachefile, tempfile) != 0)
   {
-    if (cur->security & ENCRYPT)
+    if ((fpin = fopen (cachefile, "r")) == NULL)
+      return -1;
+    if ((fpout = safe_fopen (tempfile, "w")) == NULL)
     {
-      if (cur->security & APPLICATION_SMIME)
-	crypt_smime_getkeys (cur->env);
-      if (!crypt_valid_passphrase(cur->security))
-	goto cleanup;
-
-      cmflags |= MUTT_CM_VERIFY;
+      safe_fclose (&fpin);
+      return -1;
     }
-    else if (cur->security & SIGN)
+    rc = mutt_copy_stream (fpin, fpout);
+    safe_fclose (&fpin);
+    if (safe_fclose (&fpout) != 0 || rc != 0)
     {
-      /* find out whether or not the verify signature */
-      /* L10N: Used for the $crypt_verify_sig prompt */
-      if (query_quadoption (OPT_VERIFYSIG, _("Verify signature?")) == MUTT_YES)
-      {
-	cmflags |= MUTT_CM_VERIFY;
-      }
+      mutt_unlink (tempfile);
+      return -1;
     }
   }
 
-  if (cmflags & MUTT_CM_VERIFY || cur->security & ENCRYPT)
+  /* the least recently displayed entries are removed first */
+  utime (cachefile, NULL);
+  dprint (2, (debugfile, "render_cache_fetch: using %s\n", cachefile));
+  return 0;
+}
+
+struct render_cache_entry
+{
+  char *name;
+  time_t mtime;
+  LOFF_T size;
+};
+
+static int render_cache_entry_cmp (const void *a, const void *b)
+{
+  const struct render_cache_entry *ea = (const struct render_cache_entry *) a;
+  const struct render_cache_entry *eb = (const struct render_cache_entry *) b;
+
+  if (ea->mtime != eb->mtime)
+    return ea->mtime < eb->mtime ? -1 : 1;
+  return mutt_strcmp (ea->name, eb->name);
+}
+
+/* The size of $render_cachedir as of its last scan plus what was stored
+ * since, or -1 before the first scan.  Other instances may be using the
+ * same directory, so this only decides when it's worth scanning. */
+static LOFF_T RenderCacheTotal = -1;
+static char *RenderCacheTotalDir = NULL;
+
+/* Notes that added bytes were stored.  Once the cache seems to have
+ * grown beyond $render_cache_size, removes the least recently used
+ * entries until it is back under it. */
+static void render_cache_trim (LOFF_T added)
+{
+  struct render_cache_entry *entries = NULL;
+  struct dirent *de;
+  struct stat sb;
+  BUFFER *path;
+  DIR *dp;
+  LOFF_T total = 0;
+  int count = 0, max = 0, i;
+
+  if (RenderCacheSize <= 0)
+    return;
+
+  if (RenderCacheTotal >= 0 &&
+      !mutt_strcmp (RenderCacheTotalDir, RenderCachedir))
   {
-    if (cur->security & APPLICATION_PGP)
-    {
-      if (cur->env->from)
-        crypt_pgp_invoke_getkeys (cur->env->from);
+    RenderCacheTotal += added;
+    if (RenderCacheTotal <= RenderCacheSize)
+      return;
+  }
 
-      crypt_invoke_message (APPLICATION_PGP);
+  if ((dp = opendir (RenderCachedir)) == NULL)
+    return;
+
+  path = mutt_buffer_pool_get ();
+  while ((de = readdir (dp)) != NULL)
+  {
+    if (mutt_strlen (de->d_name) != 32)
+      continue;
+    mutt_buffer_printf (path, "%s/%s", RenderCachedir, de->d_name);
+    if (stat (mutt_b2s (path), &sb) != 0 || !S_ISREG (sb.st_mode))
+      continue;
+    if (count == max)
+      safe_realloc (&entries, (max += 64) * sizeof (struct render_cache_entry));
+    entries[count].name = safe_strdup (de->d_name);
+    entries[count].mtime = sb.st_mtime;
+    entries[count].size = sb.st_size;
+    total += sb.st_size;
+    count++;
+  }
+  closedir (dp);
+
+  if (total > RenderCacheSize)
+  {
+    qsort (entries, count, sizeof (struct render_cache_entry),
+           render_cache_entry_cmp);
+    for (i = 0; i < count && total > RenderCacheSize; i++)
+    {
+      mutt_buffer_printf (path, "%s/%s", RenderCachedir, entries[i].name);
+      if (unlink (mutt_b2s (path)) == 0)
+        total -= entries[i].size;
     }
+  }
 
-    if (cur->security & APPLICATION_SMIME)
-      crypt_invoke_message (APPLICATION_SMIME);
+  RenderCacheTotal = total;
+  mutt_str_replace (&RenderCacheTotalDir, RenderCachedir);
+
+  for (i = 0; i < count; i++)
+    FREE (&entries[i].name);
+  FREE (&entries);
+  mutt_buffer_pool_release (&path);
+}
+
+static void render_cache_store (const char *cachefile, const char *tempfile)
+{
+  FILE *fpin = NULL, *fpout = NULL;
+  BUFFER *tmp;
+  LOFF_T size;
+  int rc = -1;
+
+  tmp = mutt_buffer_pool_get ();
+  mutt_buffer_strcpy (tmp, RenderCachedir);
+  if (mutt_mkdir (tmp->data, S_IRWXU) != 0)
+  {
+    dprint (1, (debugfile, "render_cache_store: can't create %s\n", RenderCachedir));
+    goto cleanup;
+  }
+
+  /* write under a temporary name so that no one sees a partial entry */
+  mutt_buffer_printf (tmp, "%s.%d", cachefile, (int) getpid ());
+  if ((fpin = fopen (tempfile, "r")) == NULL ||
+      (fpout = safe_fopen (mutt_b2s (tmp), "w")) == NULL)
+    goto cleanup;
+  rc = mutt_copy_stream (fpin, fpout);
+  size = ftello (fpout);
+  if (safe_fclose (&fpout) != 0 || rc != 0 ||
+      rename (mutt_b2s (tmp), cachefile) != 0)
+  {
+    mutt_unlink (mutt_b2s (tmp));
+    goto cleanup;
   }
 
+  render_cache_trim (size);
 
-  tempfile = mutt_buffer_pool_get ();
-  mutt_buffer_mktemp (tempfile);
-  if ((fpout = safe_fopen (mutt_b2s (tempfile), "w")) == NULL)
+cleanup:
+  safe_fclose (&fpin);
+  safe_fclose (&fpout);
+  mutt_buffer_pool_release (&tmp);
+}
+
+/* Writes the message, as it is to be displayed, to tempfile.  Returns
+ * 0 on success, 1 if the display filter exited with an error (its
+ * output is still there), and -1 on failure.
+ */
+static int render_message (HEADER *cur, int cmflags, int chflags, int builtin,
+                           const char *tempfile)
+{
+  FILE *fpout = NULL;
+  FILE *fpfilterout = NULL;
+  pid_t filterpid = -1;
+  int res, rc = 0;
+
+  if ((fpout = safe_fopen (tempfile, "w")) == NULL)
   {
     mutt_error _("Could not create temporary file!");
-    goto cleanup;
+    return -1;
   }
 
   if (DisplayFilter)
@@ -222,14 +418,12 @@ int mutt_display_message (HEADER *cur)
     {
       mutt_error (_("Cannot create display filter"));
       safe_fclose (&fpfilterout);
-      unlink (mutt_b2s (tempfile));
-      goto cleanup;
+      unlink (tempfile);
+      return -1;
     }
   }
 
-  if (!Pager || mutt_strcmp (Pager, "builtin") == 0)
-    builtin = 1;
-  else
+  if (!builtin)
   {
     char buf[LONG_STRING];
     struct hdr_format_info hfi;
@@ -242,9 +436,7 @@ int mutt_display_message (HEADER *cur)
     fputs ("\n\n", fpout);
   }
 
-  res = mutt_copy_message (fpout, Context, cur, cmflags,
-                           (option (OPTWEED) ? (CH_WEED | CH_REORDER) : 0) |
-                           CH_DECODE | CH_FROM | CH_DISPLAY);
+  res = mutt_copy_message (fpout, Context, cur, cmflags, chflags);
   if ((safe_fclose (&fpout) != 0 && errno != EPIPE) || res < 0)
   {
     mutt_error (_("Could not copy message"));
@@ -253,15 +445,102 @@ int mutt_display_message (HEADER *cur)
       mutt_wait_filter (filterpid);
       safe_fclose (&fpfilterout);
     }
-    mutt_unlink (mutt_b2s (tempfile));
-    goto cleanup;
+    mutt_unlink (tempfile);
+    return -1;
   }
 
   if (fpfilterout != NULL && mutt_wait_filter (filterpid) != 0)
-    mutt_any_key_to_continue (NULL);
+    rc = 1;
 
   safe_fclose (&fpfilterout);	/* XXX - check result? */
 
+  return rc;
+}
+
+int mutt_display_message (HEADER *cur)
+{
+  BUFFER *tempfile = NULL, *cachefile = NULL;
+  int rc = 0, builtin;
+  int cmflags = MUTT_CM_DECODE | MUTT_CM_DISPLAY | MUTT_CM_CHARCONV;
+  int chflags;
+  int res;
+
+  mutt_parse_mime_message (Context, cur);
+  mutt_message_hook (Context, cur, MUTT_MESSAGEHOOK);
+
+  /* see if crypto is needed for this message.  if so, we should exit curses */
+  if (WithCrypto && cur->security)
+  {
+    if (cur->security & ENCRYPT)
+    {
+      if (cur->security & APPLICATION_SMIME)
+	crypt_smime_getkeys (cur->env);
+      if (!crypt_valid_passphrase(cur->security))
+	goto cleanup;
+
+      cmflags |= MUTT_CM_VERIFY;
+    }
+    else if (cur->security & SIGN)
+    {
+      /* find out whether or not the verify signature */
+      /* L10N: Used for the $crypt_verify_sig prompt */
+      if (query_quadoption (OPT_VERIFYSIG, _("Verify signature?")) == MUTT_YES)
+      {
+	cmflags |= MUTT_CM_VERIFY;
+      }
+    }
+  }
+
+  if (cmflags & MUTT_CM_VERIFY || cur->security & ENCRYPT)
+  {
+    if (cur->security & APPLICATION_PGP)
+    {
+      if (cur->env->from)
+        crypt_pgp_invoke_getkeys (cur->env->from);
+
+      crypt_invoke_message (APPLICATION_PGP);
+    }
+
+    if (cur->security & APPLICATION_SMIME)
+      crypt_invoke_message (APPLICATION_SMIME);
+  }
+
+  chflags = (option (OPTWEED) ? (CH_WEED | CH_REORDER) : 0) |
+    CH_DECODE | CH_FROM | CH_DISPLAY;
+
+  builtin = (!Pager || mutt_strcmp (Pager, "builtin") == 0);
+
+  tempfile = mutt_buffer_pool_get ();
+  mutt_buffer_mktemp (tempfile);
+
+  if (RenderCachedir && builtin &&
+      !(cur->security & (ENCRYPT | SIGN | PARTSIGN)) &&
+      render_cache_allowed (cur->content))
+  {
+    cachefile = mutt_buffer_pool_get ();
+    render_cache_path (cachefile, cur, cmflags, chflags);
+    if (render_cache_fetch (mutt_b2s (cachefile), mutt_b2s (tempfile)) == 0)
+    {
+      mutt_buffer_pool_release (&cachefile);
+      goto display;
+    }
+  }
+
+  if ((res = render_message (cur, cmflags, chflags, builtin,
+                             mutt_b2s (tempfile))) < 0)
+    goto cleanup;
+
+  if (res > 0)
+  {
+    mutt_any_key_to_continue (NULL);
+    /* don't keep what a failing filter produced */
+    mutt_buffer_pool_release (&cachefile);
+  }
+
+  if (cachefile)
+    render_cache_store (mutt_b2s (cachefile), mutt_b2s (tempfile));
+
+display:
   if (WithCrypto)
   {
     /* update crypto information for this message */
@@ -269,8 +548,9 @@ int mutt_display_message (HEADER *cur)
     cur->security |= crypt_query (cur->content);
 
     /* Remove color cache for this message, in case there
-       are color patterns for both ~g and ~V */
-    cur->pair = 0;
+       are color patterns for both ~g and ~V.  Protected headers
+       may also change the subject. */
+    mutt_reset_header_color (cur);
 
     /* Process protected headers and autocrypt gossip headers */
     process_protected_headers (cur);
@@ -342,9 +622,54 @@ int mutt_display_message (HEADER *cur)
 
 cleanup:
   mutt_buffer_pool_release (&tempfile);
+  mutt_buffer_pool_release (&cachefile);
   return rc;
 }
 
+/* Puts h into the render cache ahead of time, so that showing it next
+ * is quick.  Message hooks are not run here, as they would change the
+ * settings for the message being read; if they change how h is shown,
+ * the entry simply isn't used.
+ */
+void mutt_prerender_message (HEADER *h)
+{
+  BUFFER *tempfile, *cachefile;
+  int cmflags = MUTT_CM_DECODE | MUTT_CM_DISPLAY | MUTT_CM_CHARCONV;
+  int chflags;
+
+  if (!RenderCachedir || (Pager && mutt_strcmp (Pager, "builtin") != 0))
+    return;
+
+#ifdef USE_IMAP
+  /* without $imap_peek, fetching an unread message marks it read */
+  if (Context->magic == MUTT_IMAP && !h->read && !option (OPTIMAPPEEK))
+    return;
+#endif
+
+  mutt_parse_mime_message (Context, h);
+  if ((h->security & (ENCRYPT | SIGN | PARTSIGN)) ||
+      !render_cache_allowed (h->content))
+    return;
+
+  chflags = (option (OPTWEED) ? (CH_WEED | CH_REORDER) : 0) |
+    CH_DECODE | CH_FROM | CH_DISPLAY;
+
+  cachefile = mutt_buffer_pool_get ();
+  render_cache_path (cachefile, h, cmflags, chflags);
+  if (access (mutt_b2s (cachefile), F_OK) != 0)
+  {
+    dprint (2, (debugfile, "mutt_prerender_message: rendering message %d\n",
+                h->index + 1));
+    tempfile = mutt_buffer_pool_get ();
+    mutt_buffer_mktemp (tempfile);
+    if (render_message (h, cmflags, chflags, 1, mutt_b2s (tempfile)) == 0)
+      render_cache_store (mutt_b2s (cachefile), mutt_b2s (tempfile));
+    mutt_unlink (mutt_b2s (tempfile));
+    mutt_buffer_pool_release (&tempfile);
+  }
+  mutt_buffer_pool_release (&cachefile);
+}
+
 void ci_bounce_message (HEADER *h)
 {
   char prompt[SHORT_STRING+1];
@@ -833,7 +1158,8 @@ int _mutt_save_message (HEADER *h, CONTEXT *ctx, int delete, int decode, int dec
   if (decode || decrypt)
     mutt_parse_mime_message (Context, h);
 
-  if ((rc = mutt_append_message (ctx, Context, h, cmflags, chflags)) != 0)
+  if ((rc = mx_append_message (ctx, Context, h, cmflags, chflags,
+                                delete && !decode && !decrypt)) != 0)
     return rc;
 
   if (delete)
@@ -955,13 +1281,13 @@ int mutt_save_message (HEADER *h, int delete, int decode, int decrypt)
   }
 #endif
 
-  if (mx_open_mailbox (mutt_b2s (buf), MUTT_APPEND, &ctx) != NULL)
+  if (mx_append_begin (mutt_b2s (buf), &ctx, h ? 1 : Context->tagged) == 0)
   {
     if (h)
     {
       if (_mutt_save_message(h, &ctx, delete, decode, decrypt) != 0)
       {
-        mx_close_mailbox (&ctx, NULL);
+        mx_append_end (&ctx);
         goto cleanup;
       }
     }
@@ -975,7 +1301,7 @@ int mutt_save_message (HEADER *h, int delete, int decode, int decrypt)
 	  if (_mutt_save_message(Context->hdrs[Context->v2r[i]],
                                  &ctx, delete, decode, decrypt) != 0)
           {
-            mx_close_mailbox (&ctx, NULL);
+            mx_append_end (&ctx);
             goto cleanup;
           }
 	}
@@ -984,7 +1310,9 @@ int mutt_save_message (HEADER *h, int delete, int decode, int decrypt)
 
     need_buffy_cleanup = (ctx.magic == MUTT_MBOX || ctx.magic == MUTT_MMDF);
 
-    mx_close_mailbox (&ctx, NULL);
+    /* the messages are only saved once they are on disk */
+    if (mx_append_end (&ctx) != 0)
+      goto cleanup;
 
     if (need_buffy_cleanup)
       mutt_buffy_cleanup (mutt_b2s (buf), &st);
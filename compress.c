@@ -952,4 +952,5 @@ struct mx_ops mx_comp_ops =
   .open_new_msg = open_new_message,
   .msg_padding_size = compress_msg_padding_size,
   .save_to_header_cache = NULL,  /* compressed doesn't support maildir/mh */
+  .link_msg = NULL,
 };
@@ -336,6 +336,7 @@ mutt_copy_hdr (FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end, int flags,
    CH_NOLEN             don't write Content-Length: and Lines:
    CH_NONEWLINE         don't output a newline after the header
    CH_NOSTATUS          ignore the Status: and X-Status:
+   CH_PAD_STATUS        leave room for every flag in Status: and X-Status:
    CH_PREFIX            quote header with $indent_str
    CH_REORDER           output header in order specified by `hdr_order'
    CH_TXTPLAIN          generate text/plain MIME headers [hack alert.]
@@ -398,7 +399,16 @@ mutt_copy_header (FILE *in, HEADER *h, FILE *out, int flags, const char *prefix)
     fputc ('\n', out);
   }
 
-  if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0)
+  if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0 &&
+      (flags & CH_PAD_STATUS))
+  {
+    /* room for every flag, for mbox_sync_mailbox() to fill in later */
+    fprintf (out, "Status: %c%c\n", h->read ? 'R' : ' ',
+             (h->read || h->old) ? 'O' : ' ');
+    fprintf (out, "X-Status: %c%c\n", h->replied ? 'A' : ' ',
+             h->flagged ? 'F' : ' ');
+  }
+  else if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0)
   {
     if (h->old || h->read)
     {
@@ -513,6 +523,63 @@ static int count_delete_lines (FILE *fp, BODY *b, LOFF_T *length, size_t datelen
   return dellines;
 }
 
+#ifdef HAVE_COPY_FILE_RANGE
+/* Copies length bytes from offset in fpin to fpout without passing them
+ * through user space.  On the same filesystem the kernel may even share
+ * the data blocks.
+ *
+ * Returns 1 if the files don't allow it, e.g. because fpout was opened
+ * for appending, in which case nothing was copied.  Like mutt_copy_bytes(),
+ * running out of input before length bytes were copied is an error.
+ */
+static int copy_file_range_bytes (FILE *fpin, LOFF_T offset, FILE *fpout,
+                                  LOFF_T length)
+{
+  loff_t off_in = offset;
+  LOFF_T pos;
+  ssize_t n;
+
+  if (fflush (fpout) != 0)
+    return -1;
+
+  while (length > 0)
+  {
+    if ((n = copy_file_range (fileno (fpin), &off_in, fileno (fpout), NULL,
+                              length, 0)) <= 0)
+    {
+      if (off_in == offset)
+        return 1;
+      return -1;
+    }
+    length -= n;
+  }
+
+  /* stdio doesn't know the output file offset has moved */
+  if ((pos = lseek (fileno (fpout), 0, SEEK_CUR)) == -1 ||
+      fseeko (fpout, pos, SEEK_SET) != 0)
+    return -1;
+  fseeko (fpin, off_in, SEEK_SET);
+
+  return 0;
+}
+#endif
+
+/* Copies a body as it is.  fpin must be positioned at its start. */
+static int copy_raw_body (FILE *fpin, FILE *fpout, BODY *body)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+  int rc;
+
+  /* a body fitting into the stdio buffer isn't worth the extra flush */
+  if (body->length > BUFSIZ &&
+      (rc = copy_file_range_bytes (fpin, body->offset, fpout,
+                                   body->length)) != 1)
+    return rc;
+#endif
+
+  return mutt_copy_bytes (fpin, fpout, body->length);
+}
+
 /* make a copy of a message
  *
  * fpout	where to write output
@@ -715,7 +782,7 @@ _mutt_copy_message (FILE *fpout, FILE *fpin, HEADER *hdr, BODY *body,
 	}
       }
     }
-    else if (mutt_copy_bytes (fpin, fpout, body->length) == -1)
+    else if (copy_raw_body (fpin, fpout, body) == -1)
       return -1;
   }
 
@@ -776,7 +843,11 @@ _mutt_append_message (CONTEXT *dest, FILE *fpin, CONTEXT *src, HEADER *hdr,
   if ((msg = mx_open_new_message (dest, hdr, is_from (buf, NULL, 0, NULL) ? 0 : MUTT_ADD_FROM)) == NULL)
     return -1;
   if (dest->magic == MUTT_MBOX || dest->magic == MUTT_MMDF)
+  {
     chflags |= CH_FROM | CH_FORCE_FROM;
+    if (option (OPTMBOXPADSTATUS))
+      chflags |= CH_PAD_STATUS;
+  }
   chflags |= (dest->magic == MUTT_MAILDIR ? CH_NOSTATUS : CH_UPDATE);
   r = _mutt_copy_message (msg->fp, fpin, hdr, body, flags, chflags);
   if (mx_commit_message (msg, dest) != 0)
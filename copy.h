@@ -55,6 +55,7 @@
 #define CH_DISPLAY        (1<<18) /* display result to user */
 #define CH_UPDATE_LABEL   (1<<19) /* update X-Label: from hdr->env->x_label? */
 #define CH_UPDATE_SUBJECT (1<<20) /* update Subject: protected header update */
+#define CH_PAD_STATUS     (1<<21) /* pad Status: and X-Status: for $mbox_pad_status */
 
 
 int mutt_copy_hdr (FILE *, FILE *, LOFF_T, LOFF_T, int, const char *);
@@ -126,6 +126,31 @@ void mutt_getch_timeout (int delay)
   timeout (delay);
 }
 
+/* Returns 1 if no key is pressed within delay milliseconds.  A key that
+ * is pressed is left in the input queue.
+ */
+int mutt_idle (int delay)
+{
+  int ch;
+
+  if (UngetCount || MacroBufferCount)
+    return 0;
+
+  SigInt = 0;
+  mutt_allow_interrupt (1);
+  timeout (delay);
+  ch = getch ();
+  timeout (MuttGetchTimeout);
+  mutt_allow_interrupt (0);
+
+  if (ch != ERR)
+  {
+    ungetch (ch);
+    return 0;
+  }
+  return !(SigInt || SigWinch);
+}
+
 #ifdef USE_INOTIFY
 static int mutt_monitor_getch (void)
 {
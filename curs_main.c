@@ -205,8 +205,132 @@ void mutt_ts_icon(char *str)
   fprintf(stderr, "\033]1;%s\007", str);
 }
 
+/* Index lines are cached on their header and reused as long as nothing
+ * they may depend on has changed: the header itself (h->gen), the
+ * messages hidden in its thread if it is collapsed (ctx->gen), its place
+ * in the index and thread, the window width, and anything set by a
+ * config command, a resort or a thread redraw (IndexRowGen). */
+typedef struct index_row
+{
+  unsigned long gen;
+  unsigned long hdrgen;
+  unsigned long ctxgen;
+  size_t len;
+  format_flag flags;
+  int cols;
+  int msgno;
+  int virtual;
+  int msgcount;
+  int msgnotreadyet;
+  int lines;
+  unsigned int security;
+  int collapsed;
+  int num_hidden;
+  /* the line itself follows */
+} INDEX_ROW;
+
+/* Lines can't be cached if the format shows the current time (%<...>),
+ * uses an index-format-hook (%@...@, whose patterns may match dates
+ * relative to now) or is run through a filter.  This only looks at the
+ * format once after each change. */
+static int index_format_cacheable (void)
+{
+  static const char *fmt = NULL;
+  static unsigned long gen;
+  static int cacheable;
+  const char *p;
+  size_t n;
+
+  if (fmt == HdrFmt && gen == IndexRowGen)
+    return cacheable;
+  fmt = HdrFmt;
+  gen = IndexRowGen;
+  cacheable = 0;
+
+  if (!fmt)
+    return 0;
+
+  for (p = fmt; *p; p++)
+  {
+    if (*p == '\\' && p[1])
+      p++;
+    else if (*p == '%')
+    {
+      if (*++p == '?')
+	p++;
+      while (isdigit ((unsigned char) *p) || *p == '.' || *p == '-' || *p == '=')
+	p++;
+      if (*p == '<' || *p == '@')
+	return 0;
+      if (!*p)
+	break;
+    }
+  }
+
+  n = mutt_strlen (fmt);
+  if (n > 1 && fmt[n - 1] == '|')
+    return 0;
+
+  return (cacheable = 1);
+}
+
+static void index_row_key (INDEX_ROW *key, HEADER *h, size_t l, format_flag flag)
+{
+  key->gen = IndexRowGen;
+  key->hdrgen = h->gen;
+  /* %M and %Z of a collapsed thread reflect the messages hidden in it */
+  key->ctxgen = (h->collapsed && h->num_hidden > 1) ? Context->gen : 0;
+  key->len = l;
+  key->flags = flag;
+  key->cols = MuttIndexWindow->cols;
+  key->msgno = h->msgno;
+  key->virtual = h->virtual;
+  key->msgcount = Context->msgcount;
+  key->msgnotreadyet = Context->msgnotreadyet;
+  key->lines = h->lines;
+  key->security = h->security;
+  key->collapsed = h->collapsed;
+  key->num_hidden = h->num_hidden;
+}
+
+static int index_row_fetch (HEADER *h, const INDEX_ROW *key, char *s)
+{
+  INDEX_ROW *row = h->index_row;
+
+  if (!row ||
+      row->gen != key->gen ||
+      row->hdrgen != key->hdrgen ||
+      row->ctxgen != key->ctxgen ||
+      row->len != key->len ||
+      row->flags != key->flags ||
+      row->cols != key->cols ||
+      row->msgno != key->msgno ||
+      row->virtual != key->virtual ||
+      row->msgcount != key->msgcount ||
+      row->msgnotreadyet != key->msgnotreadyet ||
+      row->lines != key->lines ||
+      row->security != key->security ||
+      row->collapsed != key->collapsed ||
+      row->num_hidden != key->num_hidden)
+    return 0;
+
+  strfcpy (s, (char *) (row + 1), key->len);
+  return 1;
+}
+
+static void index_row_store (HEADER *h, const INDEX_ROW *key, const char *s)
+{
+  size_t len = mutt_strlen (s) + 1;
+
+  safe_realloc (&h->index_row, sizeof (INDEX_ROW) + len);
+  *h->index_row = *key;
+  memcpy ((char *) (h->index_row + 1), s, len);
+}
+
 void index_make_entry (char *s, size_t l, MUTTMENU *menu, int num)
 {
+  INDEX_ROW key;
+  int cacheable;
   format_flag flag = MUTT_FORMAT_ARROWCURSOR | MUTT_FORMAT_INDEX;
   int edgemsgno, reverse = Sort & SORT_REVERSE;
   HEADER *h = Context->hdrs[Context->v2r[num]];
@@ -264,7 +388,17 @@ void index_make_entry (char *s, size_t l, MUTTMENU *menu, int num)
     }
   }
 
+  if ((cacheable = index_format_cacheable ()))
+  {
+    index_row_key (&key, h, l, flag);
+    if (index_row_fetch (h, &key, s))
+      return;
+  }
+
   _mutt_make_string (s, l, NONULL (HdrFmt), Context, h, flag);
+
+  if (cacheable)
+    index_row_store (h, &key, s);
 }
 
 int index_color (int index_no)
@@ -1489,6 +1623,8 @@ int mutt_index_menu (void)
 	    HEADER *oldcur = CURHDR;
 
 	    mutt_break_thread (CURHDR);
+	    CURHDR->gen++;
+	    Context->gen++;
 	    mutt_sort_headers (Context, 1);
 	    menu->current = oldcur->virtual;
 	  }
@@ -2587,22 +2723,61 @@ int mutt_index_menu (void)
   return (close);
 }
 
+/* number of color index rules whose results can be remembered */
+#define COLOR_CACHE_BITS (sizeof (unsigned long) * 8)
+
 void mutt_set_header_color (CONTEXT *ctx, HEADER *curhdr)
 {
   COLOR_LINE *color;
   pattern_cache_t cache;
+  unsigned long bit;
+  int i, rc;
 
   if (!curhdr)
     return;
 
   memset (&cache, 0, sizeof (cache));
 
-  for (color = ColorIndexList; color; color = color->next)
-    if (mutt_pattern_exec (color->color_pattern, MUTT_MATCH_FULL_ADDRESS, ctx, curhdr,
-                           &cache))
+  /* results of stable rules survive flag changes, so a message marked
+   * read doesn't have to be matched against every ~b or ~f rule again */
+  if (curhdr->color_gen != ColorIndexGen)
+  {
+    curhdr->color_gen = ColorIndexGen;
+    curhdr->color_known = curhdr->color_matched = 0;
+  }
+
+  for (color = ColorIndexList, i = 0; color; color = color->next, i++)
+  {
+    bit = (color->stable && i < COLOR_CACHE_BITS) ? 1UL << i : 0;
+
+    if (curhdr->color_known & bit)
+      rc = (curhdr->color_matched & bit) ? 1 : 0;
+    else
+    {
+      rc = mutt_pattern_exec (color->color_pattern, MUTT_MATCH_FULL_ADDRESS,
+                              ctx, curhdr, &cache);
+      if (bit && rc >= 0)
+      {
+        curhdr->color_known |= bit;
+        if (rc)
+          curhdr->color_matched |= bit;
+      }
+    }
+
+    if (rc)
     {
       curhdr->pair = color->pair;
       return;
     }
+  }
   curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
 }
+
+/* Forgets h's index color, including cached results of stable rules, for
+ * when its headers or content changed.  The color is recomputed when the
+ * message is next drawn. */
+void mutt_reset_header_color (HEADER *h)
+{
+  h->pair = 0;
+  h->color_known = 0;
+}
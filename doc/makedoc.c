@@ -360,7 +360,8 @@ enum
   DT_MAGIC,
   DT_SYN,
   DT_ADDR,
-  DT_MBCHARTBL
+  DT_MBCHARTBL,
+  DT_FSYNC
 };
 
 struct
@@ -383,6 +384,7 @@ struct
     { "DT_SYN",	NULL },
     { "DT_ADDR",	"e-mail address" },
     { "DT_MBCHARTBL", "string"	},
+    { "DT_FSYNC",	"fsync mode" },
     { NULL, NULL }
   };
 
@@ -524,6 +526,16 @@ static void pretty_default (char *t, size_t l, const char *s, int type)
       for (; *t; t++) *t = tolower ((unsigned char) *t);
       break;
     }
+    case DT_FSYNC:
+    {
+      /* heuristic! */
+      if (strncmp (s, "MUTT_FSYNC_", 11))
+        fprintf (stderr,
+                 "WARNING: expected prefix of MUTT_FSYNC_ for type DT_FSYNC instead of %s\n", s);
+      strncpy (t, s + 11, l);
+      for (; *t; t++) *t = tolower ((unsigned char) *t);
+      break;
+    }
     case DT_STR:
     case DT_RX:
     case DT_ADDR:
@@ -106,6 +106,7 @@ my %type2human = ("DT_NONE"  => "-none-",
                   "DT_SORT"  => "sort order",
                   "DT_RX"    => "regular expression",
                   "DT_MAGIC" => "folder magic",
+                  "DT_FSYNC" => "fsync mode",
                   "DT_ADDR"  => "e-mail address",
                   "DT_MBCHARTBL"=> "string");
 
@@ -278,6 +279,13 @@ sub pretty_default($$) {
     $val =~ s/^MUTT_//;
     $val = lc $val;
   }
+  elsif ($type eq "DT_FSYNC") {
+    if ($val !~ /^MUTT_FSYNC_/) {
+      die "Expected MUTT_FSYNC_ prefix instead of $val\n";
+    }
+    $val =~ s/^MUTT_FSYNC_//;
+    $val = lc $val;
+  }
   elsif (exists $string_types{$type}) {
     if ($val eq "0") {
       $val = "";
@@ -272,7 +272,9 @@ void _mutt_set_flag (CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
 
   if (update)
   {
-    mutt_set_header_color(ctx, h);
+    h->gen++;
+    ctx->gen++;
+    h->pair = 0; /* recomputed when the message is next drawn */
 #ifdef USE_SIDEBAR
     mutt_set_current_menu_redraw (REDRAW_SIDEBAR);
 #endif
@@ -21,6 +21,15 @@ WHERE void (*mutt_message) (const char *, ...);
 
 WHERE CONTEXT *Context;
 
+/* bumped on anything that may change how index lines are formatted */
+WHERE unsigned long IndexRowGen;
+/* bumped when cached results of stable index color patterns may be stale */
+WHERE unsigned long ColorIndexGen;
+/* bumped when the header or body color patterns change */
+WHERE unsigned long ColorBodyGen;
+/* bumped whenever the whole screen is cleared for a full redraw */
+WHERE unsigned long ScreenClearGen;
+
 WHERE char Errorbuf[STRING];
 WHERE char AttachmentMarker[STRING];
 WHERE char ProtectedHeaderMarker[STRING];
@@ -62,6 +71,7 @@ WHERE char *ForwardAttrIntro;
 WHERE char *ForwardAttrTrailer;
 WHERE char *ForwFmt;
 WHERE char *Fqdn;
+WHERE short FsyncMode;
 WHERE char *HdrFmt;
 WHERE char *HistFile;
 WHERE char *Homedir;
@@ -79,6 +89,7 @@ WHERE char *Inbox;
 WHERE char *Ispell;
 WHERE char *MailcapPath;
 WHERE char *Maildir;
+WHERE char *MailCheckStatsCache;
 #if defined(USE_IMAP) || defined(USE_POP)
 WHERE char *MessageCachedir;
 #endif
@@ -129,6 +140,9 @@ WHERE char *NewMailCmd;
 WHERE char *QueryCmd;
 WHERE char *QueryFormat;
 WHERE char *Realname;
+WHERE char *RenderCachedir;
+WHERE long  RenderCacheSize;
+WHERE short RenderPrefetch;
 WHERE short SearchContext;
 WHERE char *SendCharset;
 WHERE char *SendMultipartAltFilter;
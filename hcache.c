@@ -63,6 +63,7 @@ struct header_cache
   VILLA *db;
   char *folder;
   unsigned int crc;
+  int batch;			/* a transaction is open */
 };
 #elif HAVE_TC
 struct header_cache
@@ -70,6 +71,7 @@ struct header_cache
   TCBDB *db;
   char *folder;
   unsigned int crc;
+  int batch;			/* a transaction is open */
 };
 #elif HAVE_KC
 struct header_cache
@@ -77,6 +79,7 @@ struct header_cache
   KCDB *db;
   char *folder;
   unsigned int crc;
+  int batch;			/* a transaction is open */
 };
 #elif HAVE_GDBM
 struct header_cache
@@ -720,10 +723,14 @@ mutt_hcache_dump(header_cache_t *h, HEADER * header, int *off,
   nh.num_hidden = 0;
   nh.recipient = 0;
   nh.pair = 0;
+  nh.color_gen = 0;
+  nh.color_known = 0;
+  nh.color_matched = 0;
   nh.attach_valid = 0;
   nh.path = NULL;
   nh.tree = NULL;
   nh.thread = NULL;
+  nh.index_row = NULL;
 #ifdef MIXMASTER
   nh.chain = NULL;
 #endif
@@ -796,16 +803,27 @@ mutt_hcache_fetch(header_cache_t *h, const char *filename,
 void *
 mutt_hcache_fetch_raw (header_cache_t *h, const char *filename,
                        size_t(*keylen) (const char *fn))
+{
+  return mutt_hcache_fetch_raw_len (h, filename, keylen, NULL);
+}
+
+/* Like mutt_hcache_fetch_raw(), but also stores the length of the
+ * entry in dlen if it isn't NULL. */
+void *
+mutt_hcache_fetch_raw_len (header_cache_t *h, const char *filename,
+                           size_t(*keylen) (const char *fn), size_t *dlen)
 {
 #ifndef HAVE_DB4
   BUFFER *path = NULL;
   int ksize;
   void *rv = NULL;
 #endif
-#if HAVE_TC
-  int sp;
+#if HAVE_QDBM
+  int sp = 0;
+#elif HAVE_TC
+  int sp = 0;
 #elif HAVE_KC
-  size_t sp;
+  size_t sp = 0;
 #elif HAVE_GDBM
   datum key;
   datum data;
@@ -817,6 +835,8 @@ mutt_hcache_fetch_raw (header_cache_t *h, const char *filename,
   MDB_val data;
 #endif
 
+  if (dlen)
+    *dlen = 0;
   if (!h)
     return NULL;
 
@@ -830,6 +850,8 @@ mutt_hcache_fetch_raw (header_cache_t *h, const char *filename,
 
   h->db->get(h->db, NULL, &key, &data, 0);
 
+  if (dlen && data.data)
+    *dlen = data.size;
   return data.data;
 
 #else
@@ -840,11 +862,17 @@ mutt_hcache_fetch_raw (header_cache_t *h, const char *filename,
   ksize = strlen (h->folder) + keylen (filename);
 
 #ifdef HAVE_QDBM
-  rv = vlget(h->db, mutt_b2s (path), ksize, NULL);
+  rv = vlget(h->db, mutt_b2s (path), ksize, &sp);
+  if (dlen && rv)
+    *dlen = sp;
 #elif HAVE_TC
   rv = tcbdbget(h->db, mutt_b2s (path), ksize, &sp);
+  if (dlen && rv)
+    *dlen = sp;
 #elif HAVE_KC
   rv = kcdbget(h->db, mutt_b2s (path), ksize, &sp);
+  if (dlen && rv)
+    *dlen = sp;
 #elif HAVE_GDBM
   key.dptr = path->data;
   key.dsize = ksize;
@@ -852,6 +880,8 @@ mutt_hcache_fetch_raw (header_cache_t *h, const char *filename,
   data = gdbm_fetch(h->db, key);
 
   rv = data.dptr;
+  if (dlen && rv)
+    *dlen = data.dsize;
 #elif HAVE_LMDB
   key.mv_data = path->data;
   key.mv_size = ksize;
@@ -859,7 +889,11 @@ mutt_hcache_fetch_raw (header_cache_t *h, const char *filename,
    * freed in mutt_hcache_free(). */
   if ((mdb_get_r_txn (h) == MDB_SUCCESS) &&
       (mdb_get (h->txn, h->db, &key, &data) == MDB_SUCCESS))
+  {
     rv = data.mv_data;
+    if (dlen)
+      *dlen = data.mv_size;
+  }
 #endif
 
   mutt_buffer_pool_release (&path);
@@ -1021,6 +1055,8 @@ mutt_hcache_close(header_cache_t *h)
   if (!h)
     return;
 
+  if (h->batch && !vltrancommit(h->db))
+    dprint (2, (debugfile, "vltrancommit failed for %s\n", h->folder));
   vlclose(h->db);
   FREE(&h->folder);
   FREE(&h);
@@ -1076,6 +1112,13 @@ mutt_hcache_close(header_cache_t *h)
   if (!h)
     return;
 
+  if (h->batch && !tcbdbtrancommit(h->db))
+  {
+#ifdef DEBUG
+    int ecode = tcbdbecode (h->db);
+    dprint (2, (debugfile, "tcbdbtrancommit failed for %s: %s (ecode %d)\n", h->folder, tcbdberrmsg (ecode), ecode));
+#endif
+  }
   if (!tcbdbclose(h->db))
   {
 #ifdef DEBUG
@@ -1153,6 +1196,9 @@ mutt_hcache_close(header_cache_t *h)
   if (!h)
     return;
 
+  if (h->batch && !kcdbendtran(h->db, 1))
+    dprint (2, (debugfile, "kcdbendtran failed for %s: %s (ecode %d)\n", h->folder,
+                kcdbemsg (h->db), kcdbecode (h->db)));
   if (!kcdbclose(h->db))
     dprint (2, (debugfile, "kcdbclose failed for %s: %s (ecode %d)\n", h->folder,
                 kcdbemsg (h->db), kcdbecode (h->db)));
@@ -1469,6 +1515,27 @@ cleanup:
 }
 #endif
 
+/* Groups the stores and deletes until mutt_hcache_close() into a single
+ * transaction, for backends which would otherwise commit each one.  LMDB
+ * already keeps one write transaction open until closing. */
+void
+mutt_hcache_begin_batch(header_cache_t *h)
+{
+  if (!h)
+    return;
+
+#if HAVE_QDBM
+  if (!h->batch)
+    h->batch = vltranbegin(h->db);
+#elif HAVE_TC
+  if (!h->batch)
+    h->batch = tcbdbtranbegin(h->db);
+#elif HAVE_KC
+  if (!h->batch)
+    h->batch = kcdbbegintran(h->db, 0);
+#endif
+}
+
 header_cache_t *
 mutt_hcache_open(const char *path, const char *folder, hcache_namer_t namer)
 {
@@ -270,6 +270,8 @@ static int label_message(CONTEXT *ctx, HEADER *hdr, char *new)
 
   hdr->changed = 1;
   hdr->env->changed |= MUTT_ENV_CHANGED_XLABEL;
+  hdr->gen++;
+  ctx->gen++;
   return 1;
 }
 
@@ -302,7 +304,7 @@ int mutt_label_message(HEADER *hdr)
     if (label_message(Context, hdr, new))
     {
       ++changed;
-      mutt_set_header_color (Context, hdr);
+      mutt_reset_header_color (hdr);
     }
   }
   else
@@ -314,9 +316,9 @@ int mutt_label_message(HEADER *hdr)
         if (label_message(Context, HDR_OF(i), new))
         {
           ++changed;
+          mutt_reset_header_color (HDR_OF(i));
           mutt_set_flag(Context, HDR_OF(i),
                         MUTT_TAG, 0);
-          /* mutt_set_flag re-evals the header color */
         }
     }
   }
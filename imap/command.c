@@ -53,6 +53,7 @@ static void cmd_parse_lsub (IMAP_DATA* idata, char* s);
 static void cmd_parse_fetch (IMAP_DATA* idata, char* s);
 static void cmd_parse_myrights (IMAP_DATA* idata, const char* s);
 static void cmd_parse_search (IMAP_DATA* idata, const char* s);
+static void cmd_parse_esearch (IMAP_DATA* idata, const char* s);
 static void cmd_parse_status (IMAP_DATA* idata, char* s);
 static void cmd_parse_enabled (IMAP_DATA* idata, const char* s);
 
@@ -75,6 +76,7 @@ static const char * const Capabilities[] = {
   "QRESYNC",
   "LIST-EXTENDED",
   "COMPRESS=DEFLATE",
+  "ESEARCH",
 
   NULL
 };
@@ -562,6 +564,8 @@ static int cmd_handle_untagged (IMAP_DATA* idata)
     cmd_parse_myrights (idata, s);
   else if (ascii_strncasecmp ("SEARCH", s, 6) == 0)
     cmd_parse_search (idata, s);
+  else if (ascii_strncasecmp ("ESEARCH", s, 7) == 0)
+    cmd_parse_esearch (idata, s);
   else if (ascii_strncasecmp ("STATUS", s, 6) == 0)
     cmd_parse_status (idata, s);
   else if (ascii_strncasecmp ("ENABLED", s, 7) == 0)
@@ -1116,6 +1120,50 @@ static void cmd_parse_search (IMAP_DATA* idata, const char* s)
   }
 }
 
+/* cmd_parse_esearch: store the ALL result of an RFC 4731 ESEARCH response.
+ *   The UIDs come back as a compact sequence set, eg
+ *   * ESEARCH (TAG "a12") UID ALL 4:120,130 */
+static void cmd_parse_esearch (IMAP_DATA* idata, const char* s)
+{
+  SEQSET_ITERATOR *iter;
+  char *seqset;
+  unsigned int uid;
+  HEADER *h;
+
+  dprint (2, (debugfile, "Handling ESEARCH\n"));
+
+  s = imap_next_word ((char*)s);
+  /* skip the search correlator */
+  if (*s == '(')
+  {
+    if (!(s = strchr (s, ')')))
+      return;
+    s = imap_next_word ((char*)s);
+  }
+  if (!ascii_strncasecmp ("UID", s, 3))
+    s = imap_next_word ((char*)s);
+
+  /* return data is a list of name/value pairs; we only request ALL */
+  while (*s && ascii_strncasecmp ("ALL", s, 3))
+    s = imap_next_word (imap_next_word ((char*)s));
+  if (!*s)
+    return;
+
+  s = imap_next_word ((char*)s);
+  seqset = mutt_substrdup (s, s + strcspn (s, " \r\n"));
+  if ((iter = mutt_seqset_iterator_new (seqset)) != NULL)
+  {
+    while (mutt_seqset_iterator_next (iter, &uid) == 0)
+    {
+      h = (HEADER *)int_hash_find (idata->uid_hash, uid);
+      if (h)
+        h->matched = 1;
+    }
+    mutt_seqset_iterator_free (&iter);
+  }
+  FREE (&seqset);
+}
+
 /* first cut: just do buffy update. Later we may wish to cache all
  * mailbox information, even that not desired by buffy */
 static void cmd_parse_status (IMAP_DATA* idata, char* s)
@@ -1967,6 +1967,51 @@ static int do_search (const pattern_t* search, int allpats)
   return rc;
 }
 
+/* compile_search_text: add the search key for a full-text (=b, =B, =h)
+ * pattern to buf, ignoring pat->not */
+static int compile_search_text (const pattern_t* pat, BUFFER* buf)
+{
+  char term[STRING];
+  char *delim;
+
+  switch (pat->op)
+  {
+    case MUTT_HEADER:
+      mutt_buffer_addstr (buf, "HEADER ");
+
+      /* extract header name */
+      if (! (delim = strchr (pat->p.str, ':')))
+      {
+        mutt_error (_("Header search without header name: %s"), pat->p.str);
+        return -1;
+      }
+      *delim = '\0';
+      imap_quote_string (term, sizeof (term), pat->p.str);
+      mutt_buffer_addstr (buf, term);
+      mutt_buffer_addch (buf, ' ');
+
+      /* and field */
+      *delim = ':';
+      delim++;
+      SKIPWS(delim);
+      imap_quote_string (term, sizeof (term), delim);
+      mutt_buffer_addstr (buf, term);
+      break;
+    case MUTT_BODY:
+      mutt_buffer_addstr (buf, "BODY ");
+      imap_quote_string (term, sizeof (term), pat->p.str);
+      mutt_buffer_addstr (buf, term);
+      break;
+    case MUTT_WHOLE_MSG:
+      mutt_buffer_addstr (buf, "TEXT ");
+      imap_quote_string (term, sizeof (term), pat->p.str);
+      mutt_buffer_addstr (buf, term);
+      break;
+  }
+
+  return 0;
+}
+
 /* convert mutt pattern_t to IMAP SEARCH command containing only elements
  * that require full-text search (mutt already has what it needs for most
  * match types, and does a better job (eg server doesn't support regexps). */
@@ -2009,69 +2054,269 @@ static int imap_compile_search (const pattern_t* pat, BUFFER* buf)
       mutt_buffer_addch (buf, ')');
     }
   }
-  else
-  {
-    char term[STRING];
-    char *delim;
+  else if (compile_search_text (pat, buf) < 0)
+    return -1;
 
+  return 0;
+}
+
+/* IMAP SEARCH dates have day granularity and are evaluated in the sender's
+ * (SENTSINCE) or the server's (SINCE) timezone, so date ranges are widened
+ * by this much on each side to stay a superset of the local match. */
+#define SEARCH_DATE_SLOP (24 * 60 * 60)
+
+/* returns 1 if any term of pat may need the message itself (rather than
+ * the cached envelope and flags) to be evaluated locally */
+static int search_expensive (const pattern_t* pat)
+{
+  for (; pat; pat = pat->next)
+  {
     switch (pat->op)
     {
+      case MUTT_BODY:
       case MUTT_HEADER:
-        mutt_buffer_addstr (buf, "HEADER ");
+      case MUTT_WHOLE_MSG:
+      case MUTT_MIMEATTACH:
+      case MUTT_MIMETYPE:
+        return 1;
+    }
+    if (pat->child && search_expensive (pat->child))
+      return 1;
+  }
+
+  return 0;
+}
+
+/* returns 1 if every full-text term in pat is joined to it only by
+ * non-negated ANDs.  The prefilter result is then also the exact value
+ * of each of those terms wherever it matters. */
+static int search_conjunctive (const pattern_t* pat)
+{
+  const pattern_t* clause;
+
+  if (!pat->child || !do_search (pat->child, 1))
+    return 1;
+  if (pat->op != MUTT_AND || pat->not)
+    return 0;
+
+  for (clause = pat->child; clause; clause = clause->next)
+    if (!search_conjunctive (clause))
+      return 0;
+
+  return 1;
+}
+
+/* returns 1 if the server evaluates pat (ignoring pat->not) exactly as mutt
+ * would, so that it may be negated in a prefilter */
+static int search_exact (CONTEXT* ctx, const pattern_t* pat)
+{
+  const pattern_t* clause;
+
+  switch (pat->op)
+  {
+    case MUTT_AND:
+    case MUTT_OR:
+      for (clause = pat->child; clause; clause = clause->next)
+        if (!search_exact (ctx, clause))
+          return 0;
+      return 1;
+    case MUTT_BODY:
+    case MUTT_HEADER:
+    case MUTT_WHOLE_MSG:
+      return pat->stringmatch;
+    case MUTT_READ:
+    case MUTT_UNREAD:
+    case MUTT_REPLIED:
+    case MUTT_FLAG:
+    case MUTT_DELETED:
+      /* local flag changes haven't reached the server yet */
+      return !ctx->changed;
+  }
 
-        /* extract header name */
-        if (! (delim = strchr (pat->p.str, ':')))
+  return 0;
+}
+
+/* returns 1 if the server's substring match of an address or subject
+ * header is sure to find str wherever mutt would */
+static int search_plain_string (const char* str)
+{
+  for (; *str; str++)
+    if ((unsigned char) *str >= 0x80 || strchr ("\"<>\\", *str))
+      return 0;
+
+  return 1;
+}
+
+static void compile_search_date (BUFFER* buf, const char* key, time_t t)
+{
+  struct tm *tm = gmtime (&t);
+  char date[SHORT_STRING];
+
+  snprintf (date, sizeof (date), "%s %d-%s-%d ", key, tm->tm_mday,
+            Months[tm->tm_mon], tm->tm_year + 1900);
+  mutt_buffer_addstr (buf, date);
+}
+
+/* compile_search_prefilter: convert pat into search keys matching a
+ * superset of the messages pat matches, so the server can rule out
+ * messages before mutt evaluates the whole pattern locally.
+ * Returns 1 if keys were added to buf, 0 if the server can't narrow
+ * down pat, -1 on error. */
+static int compile_search_prefilter (CONTEXT* ctx, const pattern_t* pat,
+                                     BUFFER* buf)
+{
+  BUFFER *term, *clausebuf;
+  const pattern_t* clause;
+  char tmp[STRING];
+  int rc = 0;
+
+  /* the negation of a superset is no superset of anything */
+  if (pat->not && !search_exact (ctx, pat))
+    return 0;
+
+  term = mutt_buffer_pool_get ();
+  switch (pat->op)
+  {
+    case MUTT_AND:
+    case MUTT_OR:
+      clausebuf = mutt_buffer_pool_get ();
+      mutt_buffer_addch (term, '(');
+      for (clause = pat->child; clause; clause = clause->next)
+      {
+        mutt_buffer_clear (clausebuf);
+        if ((rc = compile_search_prefilter (ctx, clause, clausebuf)) < 0)
+          break;
+        if (!rc)
         {
-          mutt_error (_("Header search without header name: %s"), pat->p.str);
-          return -1;
+          /* an AND just loses a constraint, but an OR loses all of them */
+          if (pat->op == MUTT_OR)
+            break;
+          continue;
         }
-        *delim = '\0';
-        imap_quote_string (term, sizeof (term), pat->p.str);
-        mutt_buffer_addstr (buf, term);
-        mutt_buffer_addch (buf, ' ');
-
-        /* and field */
-        *delim = ':';
-        delim++;
-        SKIPWS(delim);
-        imap_quote_string (term, sizeof (term), delim);
-        mutt_buffer_addstr (buf, term);
+        if (mutt_buffer_len (term) > 1)
+          mutt_buffer_addch (term, ' ');
+        if (pat->op == MUTT_OR && clause->next)
+          mutt_buffer_addstr (term, "OR ");
+        mutt_buffer_addstr (term, mutt_b2s (clausebuf));
+      }
+      mutt_buffer_pool_release (&clausebuf);
+      if (rc < 0 || (pat->op == MUTT_OR && !rc))
         break;
-      case MUTT_BODY:
-        mutt_buffer_addstr (buf, "BODY ");
-        imap_quote_string (term, sizeof (term), pat->p.str);
-        mutt_buffer_addstr (buf, term);
+      mutt_buffer_addch (term, ')');
+      rc = mutt_buffer_len (term) > 2;
+      break;
+    case MUTT_BODY:
+    case MUTT_HEADER:
+    case MUTT_WHOLE_MSG:
+      if (pat->stringmatch)
+        rc = compile_search_text (pat, term) < 0 ? -1 : 1;
+      break;
+    case MUTT_FROM:
+    case MUTT_TO:
+    case MUTT_CC:
+    case MUTT_SUBJECT:
+      if (!pat->stringmatch || !search_plain_string (pat->p.str))
         break;
-      case MUTT_WHOLE_MSG:
-        mutt_buffer_addstr (buf, "TEXT ");
-        imap_quote_string (term, sizeof (term), pat->p.str);
-        mutt_buffer_addstr (buf, term);
+      mutt_buffer_addstr (term, pat->op == MUTT_FROM ? "FROM " :
+                                pat->op == MUTT_TO ? "TO " :
+                                pat->op == MUTT_CC ? "CC " : "SUBJECT ");
+      imap_quote_string (tmp, sizeof (tmp), pat->p.str);
+      mutt_buffer_addstr (term, tmp);
+      rc = 1;
+      break;
+    case MUTT_READ:
+    case MUTT_UNREAD:
+    case MUTT_REPLIED:
+    case MUTT_FLAG:
+    case MUTT_DELETED:
+      if (ctx->changed)
         break;
-    }
+      mutt_buffer_addstr (term, pat->op == MUTT_READ ? "SEEN" :
+                                pat->op == MUTT_UNREAD ? "UNSEEN" :
+                                pat->op == MUTT_REPLIED ? "ANSWERED" :
+                                pat->op == MUTT_FLAG ? "FLAGGED" : "DELETED");
+      rc = 1;
+      break;
+    case MUTT_SIZE:
+      /* the local size excludes the headers, so only a lower bound is
+       * safe to push to the server's RFC822.SIZE */
+      if (pat->min > 0)
+      {
+        snprintf (tmp, sizeof (tmp), "LARGER %d", pat->min - 1);
+        mutt_buffer_addstr (term, tmp);
+        rc = 1;
+      }
+      break;
+    case MUTT_DATE:
+    case MUTT_DATE_RECEIVED:
+      if (pat->dynamic)
+        break;
+      if (pat->min > SEARCH_DATE_SLOP)
+        compile_search_date (term, pat->op == MUTT_DATE ? "SENTSINCE" : "SINCE",
+                             (time_t) pat->min - SEARCH_DATE_SLOP);
+      if (pat->max < time (NULL))
+        compile_search_date (term, pat->op == MUTT_DATE ? "SENTBEFORE" : "BEFORE",
+                             (time_t) pat->max + 2 * SEARCH_DATE_SLOP);
+      /* drop the trailing separator */
+      if ((rc = mutt_buffer_len (term) > 0))
+        *--term->dptr = '\0';
+      break;
   }
 
-  return 0;
+  if (rc > 0)
+  {
+    if (pat->not)
+      mutt_buffer_addstr (buf, "NOT ");
+    mutt_buffer_addstr (buf, mutt_b2s (term));
+  }
+  mutt_buffer_pool_release (&term);
+
+  return rc;
 }
 
+/* imap_search: have the server evaluate what it can of pat, setting
+ * h->matched for the messages it returns.
+ * Returns 1 if the result is a prefilter: messages without h->matched set
+ * cannot match pat, and full-text terms evaluate to h->matched.
+ * Returns 0 if h->matched is only the result of the full-text terms,
+ * -1 on error. */
 int imap_search (CONTEXT* ctx, const pattern_t* pat)
 {
   BUFFER buf;
   IMAP_DATA* idata = (IMAP_DATA*)ctx->data;
-  int i;
+  int i, rc, prefilter = 0;
 
   for (i = 0; i < ctx->msgcount; i++)
     ctx->hdrs[i]->matched = 0;
 
-  if (!do_search (pat, 1))
+  if (search_conjunctive (pat) && (do_search (pat, 1) || search_expensive (pat)))
+    prefilter = 1;
+  else if (!do_search (pat, 1))
     return 0;
 
   mutt_buffer_init (&buf);
-  mutt_buffer_addstr (&buf, "UID SEARCH ");
-  if (imap_compile_search (pat, &buf) < 0)
+  if (mutt_bit_isset (idata->capabilities, ESEARCH))
+    mutt_buffer_addstr (&buf, "UID SEARCH RETURN (ALL) ");
+  else
+    mutt_buffer_addstr (&buf, "UID SEARCH ");
+
+  if (prefilter)
+    rc = compile_search_prefilter (ctx, pat, &buf);
+  else
+    rc = imap_compile_search (pat, &buf);
+  if (rc < 0)
   {
     FREE (&buf.data);
     return -1;
   }
+  /* nothing the server can narrow down: evaluate everything locally */
+  if (prefilter && !rc)
+  {
+    FREE (&buf.data);
+    return 0;
+  }
+
+  dprint (3, (debugfile, "imap_search: %s\n", buf.data));
   if (imap_exec (idata, buf.data, 0) < 0)
   {
     FREE (&buf.data);
@@ -2079,7 +2324,7 @@ int imap_search (CONTEXT* ctx, const pattern_t* pat)
   }
 
   FREE (&buf.data);
-  return 0;
+  return prefilter;
 }
 
 int imap_subscribe (char *path, int subscribe)
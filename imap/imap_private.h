@@ -122,6 +122,7 @@ enum
   QRESYNC,                      /* RFC 7162 */
   LIST_EXTENDED,                /* RFC 5258: IMAP4 - LIST Command Extensions */
   COMPRESS_DEFLATE,             /* RFC 4978: COMPRESS=DEFLATE */
+  ESEARCH,                      /* RFC 4731: IMAP4 Extension to SEARCH */
 
   CAPMAX
 };
@@ -1116,6 +1116,9 @@ parsemsg:
   }
 
   h->content->length = ftell (msg->fp) - h->content->offset;
+  /* the envelope and size are now taken from the full message */
+  h->gen++;
+  ctx->gen++;
 
   /* This needs to be done in case this is a multipart message */
 #if defined(HAVE_PGP) || defined(HAVE_SMIME)
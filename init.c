@@ -43,6 +43,7 @@
 #include "mx.h"
 #include "init.h"
 #include "mailbox.h"
+#include "md5.h"
 
 #include <ctype.h>
 #include <stdlib.h>
@@ -1810,6 +1811,7 @@ static void mutt_restore_default (struct option_t *p)
     case DT_NUM:
     case DT_SORT:
     case DT_MAGIC:
+    case DT_FSYNC:
       *((short *) p->data.p) = p->init.l;
       break;
     case DT_LNUM:
@@ -2489,6 +2491,31 @@ static int parse_set (BUFFER *tmp, BUFFER *s, union pointer_long_t udata, BUFFER
 	break;
       }
     }
+    else if (DTYPE(MuttVars[idx].type) == DT_FSYNC)
+    {
+      int val;
+
+      if (query || *s->dptr != '=')
+      {
+	snprintf (err->data, err->dsize, "%s=%s", MuttVars[idx].option,
+		  mutt_getnamebyvalue (*((short *) MuttVars[idx].data.p),
+				       FsyncModes));
+	break;
+      }
+
+      CHECK_PAGER;
+      s->dptr++;
+
+      mutt_extract_token (tmp, s, 0);
+      if ((val = mutt_getvaluebyname (tmp->data, FsyncModes)) == -1)
+      {
+	snprintf (err->data, err->dsize, _("Invalid value for option %s: \"%s\""),
+		  MuttVars[idx].option, tmp->data);
+	r = -1;
+	break;
+      }
+      *((short *) MuttVars[idx].data.p) = val;
+    }
     else if (DTYPE(MuttVars[idx].type) == DT_NUM)
     {
       short *ptr = (short *) MuttVars[idx].data.p;
@@ -2856,6 +2883,8 @@ int mutt_parse_rc_line (/* const */ char *line, BUFFER *token, BUFFER *err)
     {
       if (!mutt_strcmp (token->data, Commands[i].name))
       {
+	IndexRowGen++;
+	ColorIndexGen++;
 	if (Commands[i].func (token, &expn, Commands[i].data, err) != 0)
 	  goto finish;
         break;
@@ -3224,6 +3253,9 @@ static int var_to_string (int idx, char* val, size_t len)
     }
     strfcpy (tmp, p, sizeof (tmp));
   }
+  else if (DTYPE (MuttVars[idx].type) == DT_FSYNC)
+    strfcpy (tmp, NONULL (mutt_getnamebyvalue (*((short *) MuttVars[idx].data.p),
+                                               FsyncModes)), sizeof (tmp));
   else if (DTYPE (MuttVars[idx].type) == DT_BOOL)
     strfcpy (tmp, option (MuttVars[idx].data.l) ? "yes" : "no", sizeof (tmp));
   else
@@ -3234,6 +3266,42 @@ static int var_to_string (int idx, char* val, size_t len)
   return 1;
 }
 
+static void digest_list (struct md5_ctx *ctx, const LIST *l)
+{
+  for (; l; l = l->next)
+    md5_process_bytes (NONULL (l->data), mutt_strlen (l->data) + 1, ctx);
+  md5_process_bytes ("", 1, ctx);
+}
+
+/* Computes a digest of the values of all variables and of the lists
+ * that change how a message is displayed (header weeding and order,
+ * MIME handling).  Used to tell whether a message rendered earlier was
+ * rendered with the current settings.
+ */
+void mutt_config_digest (unsigned char *digest)
+{
+  struct md5_ctx ctx;
+  char val[LONG_STRING];
+  int idx;
+
+  md5_init_ctx (&ctx);
+  for (idx = 0; MuttVars[idx].option; idx++)
+  {
+    if (DTYPE (MuttVars[idx].type) == DT_SYN ||
+        !var_to_string (idx, val, sizeof (val)))
+      continue;
+    md5_process_bytes (MuttVars[idx].option, strlen (MuttVars[idx].option) + 1, &ctx);
+    md5_process_bytes (val, strlen (val) + 1, &ctx);
+  }
+  digest_list (&ctx, Ignore);
+  digest_list (&ctx, UnIgnore);
+  digest_list (&ctx, HeaderOrderList);
+  digest_list (&ctx, AutoViewList);
+  digest_list (&ctx, AlternativeOrderList);
+  digest_list (&ctx, MimeLookupList);
+  md5_finish_ctx (&ctx, digest);
+}
+
 /* Implement the -Q command line flag */
 int mutt_query_variables (LIST *queries)
 {
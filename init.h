@@ -41,6 +41,7 @@
 #define DT_ADDR	       10 /* e-mail address */
 #define DT_MBCHARTBL   11 /* multibyte char table */
 #define DT_LNUM        12 /* a number (long) */
+#define DT_FSYNC       13 /* $fsync_mode */
 
 #define DTYPE(x) ((x) & DT_MASK)
 
@@ -1185,6 +1186,17 @@ struct option_t MuttVars[] = {
   ** .pp
   ** This setting defaults to the contents of the environment variable \fC$$$EMAIL\fP.
   */
+  { "fsync_mode",	DT_FSYNC, R_NONE, {.p=&FsyncMode}, {.l=MUTT_FSYNC_MESSAGE} },
+  /*
+  ** .pp
+  ** Controls how Mutt makes sure messages it writes to local mailboxes
+  ** are on disk.  When set to ``message'', each message is synced to disk
+  ** as soon as it is written.  When set to ``batch'', messages saved,
+  ** copied or moved together, e.g. with \fC<tag-prefix><save-message>\fP,
+  ** are synced in one pass once all of them are written, along with the
+  ** directories they were created in.  When set to ``none'', Mutt leaves
+  ** this to the operating system.
+  */
   { "gecos_mask",	DT_RX,	 R_NONE, {.p=&GecosMask}, {.p="^[^,]*"} },
   /*
   ** .pp
@@ -1807,6 +1819,16 @@ struct option_t MuttVars[] = {
   ** When $$mail_check_stats is \fIset\fP, this variable configures
   ** how often (in seconds) mutt will update message counts.
   */
+  { "mail_check_stats_cache", DT_PATH, R_NONE, {.p=&MailCheckStatsCache}, {.p=0} },
+  /*
+  ** .pp
+  ** If set to a file, Mutt saves the message counts of the incoming
+  ** mailboxes there when it exits, along with the modification times they
+  ** were taken at.  At the next startup they are shown right away, and the
+  ** first check with $$mail_check_stats only reads the mailboxes which
+  ** changed since.  IMAP counts are shown until the server's reply
+  ** replaces them.
+  */
   { "mailcap_path",	DT_STR,	 R_NONE, {.p=&MailcapPath}, {.p=0} },
   /*
   ** .pp
@@ -1891,6 +1913,17 @@ struct option_t MuttVars[] = {
   ** .pp
   ** Also see the $$move variable.
   */
+  { "mbox_pad_status",	DT_BOOL, R_NONE, {.l=OPTMBOXPADSTATUS}, {.l=0} },
+  /*
+  ** .pp
+  ** When \fIset\fP, Mutt writes the \fCStatus:\fP and \fCX-Status:\fP
+  ** headers of messages in mbox and MMDF folders at a fixed width, even
+  ** when a message has none of their flags.  When only the read, old,
+  ** replied or flagged state of such messages changed, syncing the folder
+  ** then overwrites these headers in place, instead of rewriting the folder
+  ** from the first changed message on.  Deleting messages, or changing
+  ** anything else, still rewrites it.
+  */
   { "mbox_type",	DT_MAGIC,R_NONE, {.p=&DefaultMagic}, {.l=MUTT_MBOX} },
   /*
   ** .pp
@@ -2939,6 +2972,45 @@ struct option_t MuttVars[] = {
   ** .pp
   ** Also see $$wrap.
   */
+  { "render_cache_size",	DT_LNUM, R_NONE, {.p=&RenderCacheSize}, {.l=10485760} },
+  /*
+  ** .pp
+  ** The maximum total size, in bytes, of the entries in $$render_cachedir.
+  ** When it is exceeded, the least recently displayed entries are removed.
+  ** A value of 0 disables the limit.
+  */
+  { "render_cachedir",	DT_PATH, R_NONE, {.p=&RenderCachedir}, {.p=0} },
+  /*
+  ** .pp
+  ** Set this to a directory and mutt will keep copies of the messages it
+  ** has displayed in the internal pager here, as they looked after
+  ** decoding, character set conversion, $$auto_view filters and
+  ** $$display_filter.  Displaying the same message again with the same
+  ** settings then skips all of that.  Messages involving signatures or
+  ** encryption are never stored.
+  ** .pp
+  ** Entries are matched on the message and on the values of all
+  ** configuration variables, so a changed mailcap file, charset hook or
+  ** filter script is not noticed.  You are free to remove entries at any
+  ** time.
+  ** .pp
+  ** Also see $$render_cache_size.
+  */
+  { "render_prefetch",	DT_NUM,	 R_NONE, {.p=&RenderPrefetch}, {.l=0} },
+  /*
+  ** .pp
+  ** When this is set to a positive number of milliseconds and
+  ** $$render_cachedir is set, mutt uses the first pause of that length
+  ** while a message is shown in the internal pager to render the next
+  ** undeleted message into the cache, so that moving on to it is
+  ** instant.  Rendering happens in the foreground; keys typed meanwhile
+  ** are handled when it is done.  Message hooks are not run for this, so
+  ** a message whose hooks change how it is displayed is rendered again
+  ** when it is actually shown.  Unread IMAP messages are only rendered
+  ** ahead when $$imap_peek is set, as fetching them would mark them read.
+  ** .pp
+  ** A value of 0 disables this.
+  */
   { "reply_regexp",	DT_RX,	 R_INDEX|R_RESORT, {.p=&ReplyRegexp}, {.p="^(re([\\[0-9\\]+])*|aw):[ \t]*"} },
   /*
   ** .pp
@@ -4511,6 +4583,13 @@ const struct mapping_t SortSidebarMethods[] = {
   { NULL,		0 }
 };
 
+const struct mapping_t FsyncModes[] = {
+  { "message",	MUTT_FSYNC_MESSAGE },
+  { "batch",	MUTT_FSYNC_BATCH },
+  { "none",	MUTT_FSYNC_NONE },
+  { NULL,	0 }
+};
+
 
 /* functions used to parse commands in a rc file */
 
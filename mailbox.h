@@ -69,6 +69,10 @@ int mx_close_mailbox (CONTEXT *, int *);
 int mx_sync_mailbox (CONTEXT *, int *);
 int mx_commit_message (MESSAGE *, CONTEXT *);
 int mx_close_message (CONTEXT *, MESSAGE **);
+
+int mx_append_begin (const char *, CONTEXT *, int);
+int mx_append_message (CONTEXT *, CONTEXT *, HEADER *, int, int, int);
+int mx_append_end (CONTEXT *);
 int mx_get_magic (const char *);
 int mx_set_magic (const char *);
 int mx_check_mailbox (CONTEXT *, int *);
@@ -1273,6 +1273,8 @@ int main (int argc, char **argv, char **environ)
     if (!folder)
       folder = mutt_buffer_new ();
 
+    mutt_buffy_load_stats ();
+
     if (flags & MUTT_BUFFY)
     {
 #ifdef USE_IMAP
@@ -1344,6 +1346,7 @@ int main (int argc, char **argv, char **environ)
       mutt_index_menu ();
       if (Context)
 	FREE (&Context);
+      mutt_buffy_save_stats ();
     }
 
     exit_endwin_msg = Errorbuf;
@@ -523,12 +523,12 @@ static int mbox_commit_message (CONTEXT *ctx, MESSAGE *msg)
   if (fputc ('\n', msg->fp) == EOF)
     return -1;
 
-  if ((fflush (msg->fp) == EOF) ||
-      (fsync (fileno (msg->fp)) == -1))
+  if (mx_fsync_stream (ctx, msg->fp) != 0)
   {
     mutt_perror _("Can't write message");
     return -1;
   }
+  mx_fsync_defer (ctx, ctx->path, 0);
 
   return 0;
 }
@@ -538,12 +538,12 @@ static int mmdf_commit_message (CONTEXT *ctx, MESSAGE *msg)
   if (fputs (MMDF_SEP, msg->fp) == EOF)
     return -1;
 
-  if ((fflush (msg->fp) == EOF) ||
-      (fsync (fileno (msg->fp)) == -1))
+  if (mx_fsync_stream (ctx, msg->fp) != 0)
   {
     mutt_perror _("Can't write message");
     return -1;
   }
+  mx_fsync_defer (ctx, ctx->path, 0);
 
   return 0;
 }
@@ -827,6 +827,137 @@ void mbox_reset_atime (CONTEXT *ctx, struct stat *st)
   utime (ctx->path, &utimebuf);
 }
 
+/* a Status: or X-Status: value to overwrite in place */
+struct m_status_t
+{
+  LOFF_T offset;
+  size_t len;
+  char value[4];
+};
+
+/* Finds the value of the Status: or X-Status: header of a message, for
+ * mbox_sync_status() to overwrite with value.  A message without the
+ * header is fine as long as value is empty.
+ * Returns 0 if the value fits, 1 if there is nothing to write, -1 if the
+ * message has to be rewritten. */
+static int mbox_find_status (const char *hdr, size_t hdrlen, LOFF_T offset,
+                             const char *tag, const char *value,
+                             struct m_status_t *status)
+{
+  const char *line, *next, *end = hdr + hdrlen;
+  size_t taglen = mutt_strlen (tag);
+  int found = 0;
+
+  for (line = hdr; line < end; line = next)
+  {
+    if ((next = memchr (line, '\n', end - line)) == NULL)
+      break;
+    next++;
+
+    if ((end - line) <= taglen || ascii_strncasecmp (line, tag, taglen))
+      continue;
+
+    /* the same header twice, or folded: leave it to a rewrite */
+    if (found++ || (next < end && (*next == ' ' || *next == '\t')))
+      return -1;
+
+    status->offset = offset + (line - hdr) + taglen;
+    status->len = next - 1 - (line + taglen);
+    if (status->len && line[taglen + status->len - 1] == '\r')
+      status->len--;
+  }
+
+  if (!found)
+    return *value ? -1 : 1;
+
+  /* a space, then the flags */
+  if (status->len < mutt_strlen (value) + 1)
+    return -1;
+  strfcpy (status->value, value, sizeof (status->value));
+  return 0;
+}
+
+/* Overwrites the Status: and X-Status: headers of the changed messages in
+ * place, when nothing else about them changed and the new flags fit into
+ * the old headers.  Nothing is written unless that holds for all of them.
+ * Returns 0 on success, -1 if the mailbox has to be rewritten. */
+static int mbox_sync_status (CONTEXT *ctx)
+{
+  struct m_status_t *status = NULL;
+  HEADER *h;
+  char *hdr = NULL;
+  char value[4], *p;
+  size_t hdrlen, hdrmax = 0;
+  int nstatus = 0, statusmax = 0;
+  int i, j, rc = -1;
+
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    h = ctx->hdrs[i];
+    if (h->deleted || h->attach_del || (h->env && h->env->changed))
+      goto cleanup;
+    if (!h->changed)
+      continue;
+
+    hdrlen = h->content->offset - h->offset;
+    if (hdrlen > hdrmax)
+    {
+      safe_realloc (&hdr, hdrlen);
+      hdrmax = hdrlen;
+    }
+    if (fseeko (ctx->fp, h->offset, SEEK_SET) != 0 ||
+        fread (hdr, 1, hdrlen, ctx->fp) != hdrlen)
+      goto cleanup;
+
+    if (nstatus + 2 > statusmax)
+    {
+      statusmax += 64;
+      safe_realloc (&status, statusmax * sizeof (struct m_status_t));
+    }
+
+    p = value;
+    if (h->read)
+      *p++ = 'R';
+    if (h->read || h->old)
+      *p++ = 'O';
+    *p = '\0';
+    if ((j = mbox_find_status (hdr, hdrlen, h->offset, "Status:", value,
+                               &status[nstatus])) < 0)
+      goto cleanup;
+    if (j == 0)
+      nstatus++;
+
+    p = value;
+    if (h->replied)
+      *p++ = 'A';
+    if (h->flagged)
+      *p++ = 'F';
+    *p = '\0';
+    if ((j = mbox_find_status (hdr, hdrlen, h->offset, "X-Status:", value,
+                               &status[nstatus])) < 0)
+      goto cleanup;
+    if (j == 0)
+      nstatus++;
+  }
+
+  for (i = 0; i < nstatus; i++)
+  {
+    if (fseeko (ctx->fp, status[i].offset, SEEK_SET) != 0 ||
+        fprintf (ctx->fp, " %-*s", (int) status[i].len - 1, status[i].value) < 0)
+      goto cleanup;
+  }
+  if (fflush (ctx->fp) != 0)
+    goto cleanup;
+
+  dprint (2, (debugfile, "mbox_sync_status: %d headers updated in place\n", nstatus));
+  rc = 0;
+
+cleanup:
+  FREE (&hdr);
+  FREE (&status);
+  return rc;
+}
+
 /* return values:
  *	0	success
  *	-1	failure
@@ -888,6 +1019,23 @@ static int mbox_sync_mailbox (CONTEXT *ctx, int *index_hint)
   else if (i < 0)
     goto fatal;
 
+  /* with $mbox_pad_status, flag changes may not need a rewrite */
+  if (option (OPTMBOXPADSTATUS) && stat (ctx->path, &statbuf) == 0 &&
+      mbox_sync_status (ctx) == 0)
+  {
+    mbox_unlock_mailbox (ctx);
+    mbox_reset_atime (ctx, &statbuf);
+    if ((ctx->fp = freopen (ctx->path, "r", ctx->fp)) == NULL)
+    {
+      mutt_unblock_signals ();
+      mx_fastclose_mailbox (ctx);
+      mutt_error _("Fatal error!  Could not reopen mailbox!");
+      goto fatal;
+    }
+    mutt_unblock_signals ();
+    goto done;
+  }
+
   /* Create a temporary file to write the new version of the mailbox in. */
   tempfile = mutt_buffer_pool_get ();
   mutt_buffer_mktemp (tempfile);
@@ -981,7 +1129,8 @@ static int mbox_sync_mailbox (CONTEXT *ctx, int *index_hint)
       newOffset[i - first].hdr = ftello (fp) + offset;
 
       if (mutt_copy_message (fp, ctx, ctx->hdrs[i], MUTT_CM_UPDATE,
-                             CH_FROM | CH_UPDATE | CH_UPDATE_LEN) != 0)
+                             CH_FROM | CH_UPDATE | CH_UPDATE_LEN |
+                             (option (OPTMBOXPADSTATUS) ? CH_PAD_STATUS : 0)) != 0)
       {
 	mutt_perror (mutt_b2s (tempfile));
 	mutt_sleep (5);
@@ -1142,6 +1291,7 @@ static int mbox_sync_mailbox (CONTEXT *ctx, int *index_hint)
   mutt_buffer_pool_release (&tempfile);
   mutt_unblock_signals ();
 
+done:
   if (option(OPTCHECKMBOXSIZE))
   {
     tmp = mutt_find_mailbox (ctx->path);
@@ -1412,6 +1562,7 @@ struct mx_ops mx_mbox_ops = {
   .sync = mbox_sync_mailbox,
   .msg_padding_size = mbox_msg_padding_size,
   .save_to_header_cache = NULL,
+  .link_msg = NULL,
 };
 
 struct mx_ops mx_mmdf_ops = {
@@ -1426,4 +1577,5 @@ struct mx_ops mx_mmdf_ops = {
   .sync = mbox_sync_mailbox,
   .msg_padding_size = mmdf_msg_padding_size,
   .save_to_header_cache = NULL,
+  .link_msg = NULL,
 };
@@ -208,6 +208,7 @@ void menu_redraw_full (MUTTMENU *menu)
   /* clear() doesn't optimize screen redraws */
   move (0, 0);
   clrtobot ();
+  ScreenClearGen++;
 
   if (option (OPTHELP))
   {
@@ -247,27 +248,88 @@ void menu_redraw_sidebar (MUTTMENU *menu)
 }
 #endif
 
+static void menu_forget_rows (MUTTMENU *menu)
+{
+  int i;
+
+  for (i = 0; i < menu->rowslen; i++)
+  {
+    FREE (&menu->rows[i].text);
+    menu->rows[i].blank = 0;
+  }
+}
+
+/* returns what was last drawn on row r of the index window.  Everything
+ * is forgotten once the screen was cleared or the index lines may be
+ * formatted differently. */
+static struct menu_row_t *menu_get_row (MUTTMENU *menu, int r)
+{
+  if (menu->rows_gen != IndexRowGen || menu->rows_screen != ScreenClearGen)
+  {
+    menu_forget_rows (menu);
+    menu->rows_gen = IndexRowGen;
+    menu->rows_screen = ScreenClearGen;
+  }
+
+  if (r < 0)
+    return NULL;
+
+  if (r >= menu->rowslen)
+  {
+    safe_realloc (&menu->rows, (r + 1) * sizeof (struct menu_row_t));
+    memset (menu->rows + menu->rowslen, 0,
+            (r + 1 - menu->rowslen) * sizeof (struct menu_row_t));
+    menu->rowslen = r + 1;
+  }
+  return &menu->rows[r];
+}
+
+/* used when a row is drawn behind menu_redraw_index()'s back */
+static void menu_forget_row (MUTTMENU *menu, int r)
+{
+  struct menu_row_t *row;
+
+  if ((row = menu_get_row (menu, r)) != NULL)
+  {
+    FREE (&row->text);
+    row->blank = 0;
+  }
+}
+
 void menu_redraw_index (MUTTMENU *menu)
 {
   char buf[LONG_STRING];
-  int i;
+  struct menu_row_t *row;
+  int i, r;
   int do_color;
   int attr;
+  int current;
+  int redrawn = 0;
+  long bytes = 0;
 
   for (i = menu->top; i < menu->top + menu->pagelen; i++)
   {
+    r = i - menu->top + menu->offset;
+    row = menu_get_row (menu, r);
+
     if (i < menu->max)
     {
       attr = menu->color(i);
+      current = (i == menu->current);
 
       menu_make_entry (buf, sizeof (buf), menu, i);
       menu_pad_string (menu, buf, sizeof (buf));
 
+      /* curses would find nothing to send anyway, so don't bother it */
+      if (row && row->text && row->attr == attr && row->current == current &&
+          !mutt_strcmp (row->text, buf))
+        continue;
+
       ATTRSET(attr);
-      mutt_window_move (menu->indexwin, i - menu->top + menu->offset, 0);
+      mutt_window_move (menu->indexwin, r, 0);
       do_color = 1;
 
-      if (i == menu->current)
+      if (current)
       {
         SETCOLOR(MT_COLOR_INDICATOR);
         if (option(OPTARROWCURSOR))
@@ -283,15 +345,37 @@ void menu_redraw_index (MUTTMENU *menu)
 	addstr("   ");
 
       print_enriched_string (attr, (unsigned char *) buf, do_color);
+
+      if (row)
+      {
+        mutt_str_replace (&row->text, buf);
+        row->attr = attr;
+        row->current = current;
+        row->blank = 0;
+      }
+      bytes += mutt_strlen (buf);
     }
     else
     {
+      if (row && row->blank)
+        continue;
+
       NORMAL_COLOR;
-      mutt_window_clearline (menu->indexwin, i - menu->top + menu->offset);
+      mutt_window_clearline (menu->indexwin, r);
+
+      if (row)
+      {
+        FREE (&row->text);
+        row->blank = 1;
+      }
     }
+    redrawn++;
   }
   NORMAL_COLOR;
   menu->redraw = 0;
+
+  dprint (3, (debugfile, "menu_redraw_index: %d of %d rows redrawn, %ld bytes\n",
+              redrawn, menu->pagelen, bytes));
 }
 
 void menu_redraw_motion (MUTTMENU *menu)
@@ -310,6 +394,8 @@ void menu_redraw_motion (MUTTMENU *menu)
    * generate status messages.  So we want to call it *before* we
    * position the cursor for drawing. */
   old_color = menu->color (menu->oldcurrent);
+  menu_forget_row (menu, menu->oldcurrent + menu->offset - menu->top);
+  menu_forget_row (menu, menu->current + menu->offset - menu->top);
   mutt_window_move (menu->indexwin, menu->oldcurrent + menu->offset - menu->top, 0);
   ATTRSET(old_color);
 
@@ -354,6 +440,7 @@ void menu_redraw_current (MUTTMENU *menu)
   char buf[LONG_STRING];
   int attr = menu->color (menu->current);
 
+  menu_forget_row (menu, menu->current + menu->offset - menu->top);
   mutt_window_move (menu->indexwin, menu->current + menu->offset - menu->top, 0);
   menu_make_entry (buf, sizeof (buf), menu, menu->current);
   menu_pad_string (menu, buf, sizeof (buf));
@@ -738,6 +825,10 @@ void mutt_menuDestroy (MUTTMENU **p)
     FREE (& (*p)->dialog);
   }
 
+  for (i = 0; i < (*p)->rowslen; i++)
+    FREE (&(*p)->rows[i].text);
+  FREE (&(*p)->rows);
+
   FREE (p);		/* __FREE_CHECKED__ */
 }
 
@@ -798,6 +889,7 @@ void mutt_pop_current_menu (MUTTMENU *menu)
     {
       move (0, 0);
       clrtobot ();
+      ScreenClearGen++;
     }
   }
 }
@@ -63,6 +63,7 @@
 
 static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint);
 static int mh_check_mailbox (CONTEXT * ctx, int *index_hint);
+static void maildir_canon_filename (BUFFER *dest, const char *src);
 
 struct maildir
 {
@@ -85,8 +86,23 @@ struct mh_data
 {
   struct timespec mtime_cur;
   mode_t mh_umask;
+  HASH *canon_hash;		/* maildir: canonical file name -> HEADER, dropped
+				   whenever messages are freed */
+  int canon_count;		/* ctx->msgcount canon_hash is in step with */
+  time_t reconciled;		/* maildir: when both subdirs were last read */
+  unsigned int link_hi;		/* MH: last number a message was linked to */
+#if USE_HCACHE
+  header_cache_t *link_hc;	/* open while messages are linked in */
+#endif
 };
 
+#ifdef USE_INOTIFY
+/* Even with the monitor reporting every change, both subdirectories of the
+ * open maildir are read at least this often (seconds), in case it missed
+ * something without noticing. */
+#define MAILDIR_RECONCILE_INTERVAL 300
+#endif
+
 /* mh_sequences support */
 
 #define MH_SEQ_UNSEEN  (1 << 0)
@@ -274,9 +290,35 @@ static int mh_already_notified(BUFFY *b, int msgno)
   return rc;
 }
 
+/* The later mtime of the folder and its .mh_sequences: the counts
+ * can't have changed while it stays the same.
+ * Returns 0 on success, -1 on error. */
+static int mh_stats_stamp (BUFFY *b, struct timespec *stamp)
+{
+  BUFFER *path = NULL;
+  struct stat sb;
+  int rc = -1;
+
+  path = mutt_buffer_pool_get ();
+  if (stat (mutt_b2s (b->pathbuf), &sb) == 0)
+  {
+    mutt_get_stat_timespec (stamp, &sb, MUTT_STAT_MTIME);
+    mutt_buffer_printf (path, "%s/.mh_sequences", mutt_b2s (b->pathbuf));
+    if (stat (mutt_b2s (path), &sb) == 0 &&
+        mutt_stat_timespec_compare (&sb, MUTT_STAT_MTIME, stamp) > 0)
+      mutt_get_stat_timespec (stamp, &sb, MUTT_STAT_MTIME);
+    rc = 0;
+  }
+  mutt_buffer_pool_release (&path);
+  return rc;
+}
+
 /* Checks new mail for a mh mailbox.
  * check_stats: if true, also count total, new, and flagged messages.
  * Returns 1 if the mailbox has new mail.
+ *
+ * The counts are only taken again when the folder or its sequences
+ * changed since the last time.
  */
 int mh_buffy (BUFFY *mailbox, int check_stats)
 {
@@ -284,9 +326,19 @@ int mh_buffy (BUFFY *mailbox, int check_stats)
   struct mh_sequences mhs;
   int check_new = 1;
   int rc = 0;
+  int have_stamp = 0;
+  struct timespec stamp;
   DIR *dirp;
   struct dirent *de;
 
+  if (check_stats && mh_stats_stamp (mailbox, &stamp) == 0)
+  {
+    if (!mutt_timespec_compare (&stamp, &mailbox->stats_last_checked))
+      check_stats = 0;
+    else
+      have_stamp = 1;
+  }
+
   /* when $mail_check_recent is set and the .mh_sequences file hasn't changed
    * since the last mailbox visit, there is no "new mail" */
   if (option(OPTMAILCHECKRECENT) && mh_sequences_changed(mailbox) <= 0)
@@ -351,6 +403,12 @@ int mh_buffy (BUFFY *mailbox, int check_stats)
       }
       closedir (dirp);
     }
+
+    /* a change within the same second may not show in a coarse mtime */
+    if (have_stamp && (stamp.tv_sec < time (NULL)))
+      mailbox->stats_last_checked = stamp;
+    else
+      memset (&mailbox->stats_last_checked, 0, sizeof (struct timespec));
   }
 
   return rc;
@@ -904,6 +962,12 @@ cleanup:
 static int maildir_add_to_context (CONTEXT * ctx, struct maildir *md)
 {
   int oldmsgcount = ctx->msgcount;
+  struct mh_data *data = mh_data (ctx);
+  BUFFER *canon = NULL;
+
+  /* keep the canonical name hash in step, if there is one */
+  if (data && data->canon_hash && (data->canon_count == ctx->msgcount))
+    canon = mutt_buffer_pool_get ();
 
   while (md)
   {
@@ -928,12 +992,21 @@ static int maildir_add_to_context (CONTEXT * ctx, struct maildir *md)
 	md->h->content->length + md->h->content->offset -
 	md->h->content->hdr_offset;
 
+      if (canon)
+      {
+        maildir_canon_filename (canon, md->h->path);
+        hash_insert (data->canon_hash, mutt_b2s (canon), md->h);
+        data->canon_count++;
+      }
+
       md->h = NULL;
       ctx->msgcount++;
     }
     md = md->next;
   }
 
+  mutt_buffer_pool_release (&canon);
+
   if (ctx->msgcount > oldmsgcount)
   {
     mx_update_context (ctx, ctx->msgcount - oldmsgcount);
@@ -1251,6 +1324,13 @@ static void maildir_delayed_parsing (CONTEXT * ctx, struct maildir **md,
 
 static int mh_close_mailbox (CONTEXT *ctx)
 {
+  if (ctx->data)
+  {
+    hash_destroy (&mh_data (ctx)->canon_hash, NULL);
+#if USE_HCACHE
+    mutt_hcache_close (mh_data (ctx)->link_hc);
+#endif
+  }
   FREE (&ctx->data);
 
   return 0;
@@ -1329,6 +1409,7 @@ static int maildir_read_dir (CONTEXT * ctx)
   if (mh_read_dir (ctx, "new") == -1 || mh_read_dir (ctx, "cur") == -1)
     return (-1);
 
+  mh_data (ctx)->reconciled = time (NULL);
   return 0;
 }
 
@@ -1619,7 +1700,8 @@ static int _maildir_commit_message (CONTEXT * ctx, MESSAGE * msg, HEADER * hdr)
   BUFFER *path = NULL, *full = NULL;
   char *s;
 
-  if (safe_fsync_close (&msg->fp))
+  rc = mx_fsync_stream (ctx, msg->fp);
+  if (safe_fclose (&msg->fp) != 0 || rc != 0)
   {
     mutt_perror (_("Could not flush message to disk"));
     return -1;
@@ -1650,8 +1732,15 @@ static int _maildir_commit_message (CONTEXT * ctx, MESSAGE * msg, HEADER * hdr)
 
     if (safe_rename (msg->path, mutt_b2s (full)) == 0)
     {
+      mx_fsync_defer (ctx, mutt_b2s (full), 1);
+
       if (hdr)
+      {
 	mutt_str_replace (&hdr->path, mutt_b2s (path));
+        /* the message has a new canonical name */
+        if (ctx->data)
+          hash_destroy (&mh_data (ctx)->canon_hash, NULL);
+      }
       FREE (&msg->path);
 
       /*
@@ -1701,30 +1790,18 @@ static int maildir_commit_message (CONTEXT * ctx, MESSAGE * msg)
  */
 
 
-static int _mh_commit_message (CONTEXT * ctx, MESSAGE * msg, HEADER * hdr,
-			       short updseq)
+/* figure out the highest message number in use in an MH folder */
+static int mh_highest_msgno (const char *path, unsigned int *hi)
 {
   DIR *dirp;
   struct dirent *de;
   char *cp, *dep;
-  unsigned int n, hi = 0;
-  BUFFER *path = NULL;
-  char tmp[16];
-  int rc = 0;
+  unsigned int n;
 
-  if (safe_fsync_close (&msg->fp))
-  {
-    mutt_perror (_("Could not flush message to disk"));
+  if ((dirp = opendir (path)) == NULL)
     return -1;
-  }
 
-  if ((dirp = opendir (ctx->path)) == NULL)
-  {
-    mutt_perror (ctx->path);
-    return (-1);
-  }
-
-  /* figure out what the next message number is */
+  *hi = 0;
   while ((de = readdir (dirp)) != NULL)
   {
     dep = de->d_name;
@@ -1740,12 +1817,36 @@ static int _mh_commit_message (CONTEXT * ctx, MESSAGE * msg, HEADER * hdr,
     if (!*cp)
     {
       n = atoi (dep);
-      if (n > hi)
-	hi = n;
+      if (n > *hi)
+	*hi = n;
     }
   }
   closedir (dirp);
 
+  return 0;
+}
+
+static int _mh_commit_message (CONTEXT * ctx, MESSAGE * msg, HEADER * hdr,
+			       short updseq)
+{
+  unsigned int hi;
+  BUFFER *path = NULL;
+  char tmp[16];
+  int rc = 0;
+
+  rc = mx_fsync_stream (ctx, msg->fp);
+  if (safe_fclose (&msg->fp) != 0 || rc != 0)
+  {
+    mutt_perror (_("Could not flush message to disk"));
+    return -1;
+  }
+
+  if (mh_highest_msgno (ctx->path, &hi) != 0)
+  {
+    mutt_perror (ctx->path);
+    return (-1);
+  }
+
   /*
    * Now try to rename the file to the proper name.
    *
@@ -1762,6 +1863,7 @@ static int _mh_commit_message (CONTEXT * ctx, MESSAGE * msg, HEADER * hdr,
     mutt_buffer_printf (path, "%s/%s", ctx->path, tmp);
     if (safe_rename (msg->path, mutt_b2s (path)) == 0)
     {
+      mx_fsync_defer (ctx, mutt_b2s (path), 1);
       if (hdr)
 	mutt_str_replace (&hdr->path, tmp);
       FREE (&msg->path);
@@ -1790,6 +1892,155 @@ static int mh_commit_message (CONTEXT * ctx, MESSAGE * msg)
 }
 
 
+/*
+ * Link a message of another maildir or MH folder into this one, see
+ * mx_link_message().  Any failure to link, e.g. across filesystems,
+ * just makes the caller fall back to copying the message.
+ */
+
+#if USE_HCACHE
+/* The header cache of the folder is kept open while messages are linked
+ * in, so that the headers need not be parsed again when it is opened. */
+static header_cache_t *mh_link_hcache (CONTEXT *ctx)
+{
+  struct mh_data *data = mh_data (ctx);
+
+  if (!data->link_hc &&
+      (data->link_hc = mutt_hcache_open (HeaderCache, ctx->path, NULL)))
+    mutt_hcache_begin_batch (data->link_hc);
+
+  return data->link_hc;
+}
+#endif
+
+static int maildir_link_message (CONTEXT *dest, CONTEXT *src, HEADER *hdr)
+{
+  char subdir[4];
+  char suffix[16];
+  short deleted;
+  int rc = 0;
+  BUFFER *orig = NULL, *path = NULL, *full = NULL;
+#if USE_HCACHE
+  header_cache_t *hc;
+#endif
+
+  if (!dest->data)
+    dest->data = safe_calloc (sizeof (struct mh_data), 1);
+
+  /* the copy wouldn't carry the deleted flag either */
+  deleted = hdr->deleted;
+  hdr->deleted = 0;
+
+  maildir_flags (suffix, sizeof (suffix), hdr);
+  strfcpy (subdir, (hdr->read || hdr->old) ? "cur" : "new", sizeof (subdir));
+
+  orig = mutt_buffer_pool_get ();
+  path = mutt_buffer_pool_get ();
+  full = mutt_buffer_pool_get ();
+
+  mutt_buffer_printf (orig, "%s/%s", src->path, hdr->path);
+  FOREVER
+  {
+    mutt_buffer_printf (path, "%s/%lld.%u_%d.%s%s", subdir,
+                        (long long)time (NULL), (unsigned int)getpid (), Counter++,
+                        NONULL (Hostname), suffix);
+    mutt_buffer_printf (full, "%s/%s", dest->path, mutt_b2s (path));
+
+    if (link (mutt_b2s (orig), mutt_b2s (full)) == 0)
+      break;
+    if (errno != EEXIST)
+    {
+      dprint (1, (debugfile, "maildir_link_message: link (%s, %s): %s\n",
+                  mutt_b2s (orig), mutt_b2s (full), strerror (errno)));
+      rc = 1;
+      goto cleanup;
+    }
+  }
+
+  dprint (2, (debugfile, "maildir_link_message: linked %s to %s\n",
+              mutt_b2s (orig), mutt_b2s (full)));
+  mx_fsync_defer (dest, mutt_b2s (full), 1);
+
+#if USE_HCACHE
+  if ((hc = mh_link_hcache (dest)))
+    mutt_hcache_store (hc, mutt_b2s (path) + 3, hdr, 0, &maildir_hcache_keylen,
+                       MUTT_GENERATE_UIDVALIDITY);
+#endif
+
+cleanup:
+  hdr->deleted = deleted;
+  mutt_buffer_pool_release (&orig);
+  mutt_buffer_pool_release (&path);
+  mutt_buffer_pool_release (&full);
+
+  return rc;
+}
+
+static int mh_link_message (CONTEXT *dest, CONTEXT *src, HEADER *hdr)
+{
+  struct mh_data *data;
+  char tmp[16];
+  int rc = 0;
+  BUFFER *orig = NULL, *path = NULL;
+#if USE_HCACHE
+  header_cache_t *hc;
+  short deleted;
+#endif
+
+  if (!dest->data)
+    dest->data = safe_calloc (sizeof (struct mh_data), 1);
+  data = mh_data (dest);
+
+  /* numbers are only looked up once; links to taken ones are retried */
+  if (!data->link_hi && mh_highest_msgno (dest->path, &data->link_hi) != 0)
+    return 1;
+
+  orig = mutt_buffer_pool_get ();
+  path = mutt_buffer_pool_get ();
+
+  mutt_buffer_printf (orig, "%s/%s", src->path, hdr->path);
+  FOREVER
+  {
+    snprintf (tmp, sizeof (tmp), "%u", ++data->link_hi);
+    mutt_buffer_printf (path, "%s/%s", dest->path, tmp);
+
+    if (link (mutt_b2s (orig), mutt_b2s (path)) == 0)
+      break;
+    if (errno != EEXIST)
+    {
+      dprint (1, (debugfile, "mh_link_message: link (%s, %s): %s\n",
+                  mutt_b2s (orig), mutt_b2s (path), strerror (errno)));
+      data->link_hi--;
+      rc = 1;
+      goto cleanup;
+    }
+  }
+
+  dprint (2, (debugfile, "mh_link_message: linked %s to %s\n",
+              mutt_b2s (orig), mutt_b2s (path)));
+  mx_fsync_defer (dest, mutt_b2s (path), 1);
+
+  mh_sequences_add_one (dest, data->link_hi, !hdr->read, hdr->flagged,
+                        hdr->replied);
+
+#if USE_HCACHE
+  if ((hc = mh_link_hcache (dest)))
+  {
+    deleted = hdr->deleted;
+    hdr->deleted = 0;
+    mutt_hcache_store (hc, tmp, hdr, 0, strlen, MUTT_GENERATE_UIDVALIDITY);
+    hdr->deleted = deleted;
+  }
+#endif
+
+cleanup:
+  mutt_buffer_pool_release (&orig);
+  mutt_buffer_pool_release (&path);
+
+  return rc;
+}
+
+
 /* Sync a message in an MH folder.
  *
  * This code is also used for attachment deletion in maildir
@@ -1980,10 +2231,23 @@ cleanup:
   return (rc);
 }
 
+/* Does mh_sync_mailbox() have to write anything for the message? */
+static int mh_sync_needed (CONTEXT *ctx, HEADER *h)
+{
+  if (h->deleted && (ctx->magic != MUTT_MAILDIR || !option (OPTMAILDIRTRASH)))
+    return 1;
+
+  return h->changed || h->attach_del ||
+         (ctx->magic == MUTT_MAILDIR &&
+          (option (OPTMAILDIRTRASH) || h->trash) &&
+          (h->deleted != h->trash));
+}
+
 int mh_sync_mailbox (CONTEXT * ctx, int *index_hint)
 {
   BUFFER *path = NULL, *tmp = NULL;
   int i, j;
+  int count = 0, written = 0;
 #if USE_HCACHE
   header_cache_t *hc = NULL;
 #endif /* USE_HCACHE */
@@ -1998,24 +2262,39 @@ int mh_sync_mailbox (CONTEXT * ctx, int *index_hint)
   if (i != 0)
     return i;
 
+  /* deleted messages are about to be freed by mx_update_tables() */
+  hash_destroy (&mh_data (ctx)->canon_hash, NULL);
+
+  for (i = 0; i < ctx->msgcount; i++)
+    if (mh_sync_needed (ctx, ctx->hdrs[i]))
+      count++;
+
 #if USE_HCACHE
-  if (ctx->magic == MUTT_MAILDIR || ctx->magic == MUTT_MH)
+  if (count && (ctx->magic == MUTT_MAILDIR || ctx->magic == MUTT_MH))
+  {
     hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+    /* one commit for all the updates, not one each */
+    mutt_hcache_begin_batch (hc);
+  }
 #endif /* USE_HCACHE */
 
   if (!ctx->quiet)
   {
     snprintf (msgbuf, sizeof (msgbuf), _("Writing %s..."), ctx->path);
-    mutt_progress_init (&progress, msgbuf, MUTT_PROGRESS_MSG, WriteInc, ctx->msgcount);
+    mutt_progress_init (&progress, msgbuf, MUTT_PROGRESS_MSG, WriteInc, count);
   }
 
   path = mutt_buffer_pool_get ();
   tmp = mutt_buffer_pool_get ();
 
-  for (i = 0; i < ctx->msgcount; i++)
+  for (i = 0; i < ctx->msgcount && written < count; i++)
   {
+    if (!mh_sync_needed (ctx, ctx->hdrs[i]))
+      continue;
+
     if (!ctx->quiet)
-      mutt_progress_update (&progress, i, -1);
+      mutt_progress_update (&progress, written, -1);
+    written++;
 
     if (ctx->hdrs[i]->deleted
 	&& (ctx->magic != MUTT_MAILDIR || !option (OPTMAILDIRTRASH)))
@@ -2198,6 +2477,214 @@ static int maildir_update_flags (CONTEXT *ctx, HEADER *o, HEADER *n)
 }
 
 
+/* Merges what was found on disk (n) into the context's header (o).
+ * Returns 1 if flags changed. */
+static int maildir_merge_header (CONTEXT *ctx, HEADER *o, HEADER *n)
+{
+  int flags_changed = 0;
+
+  /* check to see if the message has moved to a different
+   * subdirectory.  If so, update the associated filename.
+   */
+  if (mutt_strcmp (o->path, n->path))
+    mutt_str_replace (&o->path, n->path);
+
+  /* if the user hasn't modified the flags on this message, update
+   * the flags we just detected.
+   */
+  if (!o->changed)
+    if (maildir_update_flags (ctx, o, n))
+      flags_changed = 1;
+
+  if (o->deleted == o->trash)
+    if (o->deleted != n->deleted)
+    {
+      o->deleted = n->deleted;
+      flags_changed = 1;
+    }
+  o->trash = n->trash;
+
+  return flags_changed;
+}
+
+#ifdef USE_INOTIFY
+/* Returns the message whose file has the canonical name canon.  The hash
+ * is rebuilt whenever it fell out of step with the context. */
+static HEADER *maildir_canon_lookup (CONTEXT *ctx, const char *canon)
+{
+  struct mh_data *data = mh_data (ctx);
+  BUFFER *buf;
+  int i;
+
+  if (data->canon_hash && (data->canon_count != ctx->msgcount))
+    hash_destroy (&data->canon_hash, NULL);
+
+  if (!data->canon_hash)
+  {
+    buf = mutt_buffer_pool_get ();
+    data->canon_hash = hash_create (ctx->msgcount, MUTT_HASH_STRDUP_KEYS);
+    for (i = 0; i < ctx->msgcount; i++)
+    {
+      maildir_canon_filename (buf, ctx->hdrs[i]->path);
+      hash_insert (data->canon_hash, mutt_b2s (buf), ctx->hdrs[i]);
+    }
+    data->canon_count = ctx->msgcount;
+    mutt_buffer_pool_release (&buf);
+  }
+
+  return hash_find (data->canon_hash, canon);
+}
+
+/* Applies the message files the monitor saw appear in and go away from
+ * the open maildir, instead of reading both subdirectories again.  Only
+ * the last event for each message counts, and it is checked against the
+ * file system, so seeing a change twice is harmless.
+ *
+ * Returns what maildir_check_mailbox() would, or -1 if the subdirectories
+ * have to be read after all.  *rescan is set if that has to be done even
+ * though their mtimes may not have changed.
+ */
+static int maildir_check_entries (CONTEXT *ctx, int *index_hint, int *rescan)
+{
+  struct mh_data *data = mh_data (ctx);
+  MONITOR_ENTRY *entries = NULL, *e;
+  HASH *last;
+  struct hash_walk_state state;
+  struct hash_elem *elem;
+  struct maildir *md = NULL, **mdlast = &md, *entry;
+  HEADER **gone = NULL;
+  HEADER *h, *n;
+  BUFFER *buf = NULL, *path = NULL;
+  struct stat sb;
+  int count = 0, ngone = 0, added = 0;
+  int have_new = 0, flags_changed = 0;
+  int i, rc;
+
+  rc = mutt_monitor_context_entries (&entries);
+  if (rc == -1)
+    *rescan = 1;
+  if (rc < 0)
+    return -1;
+
+  if (time (NULL) - data->reconciled >= MAILDIR_RECONCILE_INTERVAL)
+  {
+    mutt_monitor_free_entries (&entries);
+    *rescan = 1;
+    return -1;
+  }
+
+  if (!entries)
+    return 0;
+
+  buf = mutt_buffer_pool_get ();
+  path = mutt_buffer_pool_get ();
+
+  for (e = entries; e; e = e->next)
+    count++;
+
+  /* the last event for each message */
+  last = hash_create (count, MUTT_HASH_STRDUP_KEYS);
+  for (e = entries; e; e = e->next)
+  {
+    if (*e->name == '.')
+      continue;
+    maildir_canon_filename (buf, e->name);
+    if ((elem = hash_find_elem (last, mutt_b2s (buf))) != NULL)
+      elem->data = e;
+    else
+      hash_insert (last, mutt_b2s (buf), e);
+  }
+
+  memset (&state, 0, sizeof (state));
+  while ((elem = hash_walk (last, &state)) != NULL)
+  {
+    e = elem->data;
+    h = maildir_canon_lookup (ctx, elem->key.strkey);
+
+    if (!e->added)
+    {
+      /* unless it turned up somewhere else since */
+      if (h)
+      {
+        mutt_buffer_printf (buf, "%s/%s", ctx->path, h->path);
+        if (stat (mutt_b2s (buf), &sb) != 0)
+        {
+          safe_realloc (&gone, (ngone + 1) * sizeof (HEADER *));
+          gone[ngone++] = h;
+        }
+      }
+      continue;
+    }
+
+    mutt_buffer_printf (path, "%s/%s", e->cur ? "cur" : "new", e->name);
+    mutt_buffer_printf (buf, "%s/%s", ctx->path, mutt_b2s (path));
+    /* gone again: there's another event for that */
+    if (stat (mutt_b2s (buf), &sb) != 0)
+      continue;
+
+    n = mutt_new_header ();
+    n->old = e->cur;
+    maildir_parse_flags (n, e->name);
+    n->path = safe_strdup (mutt_b2s (path));
+
+    if (h)
+    {
+      /* renamed: the flags may have changed */
+      if (maildir_merge_header (ctx, h, n))
+        flags_changed = 1;
+      mutt_free_header (&n);
+    }
+    else
+    {
+      entry = safe_calloc (sizeof (struct maildir), 1);
+      entry->h = n;
+      entry->canon_fname = safe_strdup (elem->key.strkey);
+      *mdlast = entry;
+      mdlast = &entry->next;
+      added++;
+    }
+  }
+
+  dprint (2, (debugfile, "maildir_check_entries: %d events, %d added, %d gone\n",
+              count, added, ngone));
+
+  hash_destroy (&last, NULL);
+  mutt_monitor_free_entries (&entries);
+
+  if (ngone)
+  {
+    for (i = 0; i < ctx->msgcount; i++)
+      ctx->hdrs[i]->active = 1;
+    for (i = 0; i < ngone; i++)
+    {
+      gone[i]->active = 0;
+      maildir_canon_filename (buf, gone[i]->path);
+      hash_delete (data->canon_hash, mutt_b2s (buf), gone[i], NULL);
+    }
+    data->canon_count -= ngone;
+    maildir_update_tables (ctx, index_hint);
+    FREE (&gone);
+  }
+
+  maildir_delayed_parsing (ctx, &md, NULL);
+  have_new = maildir_move_to_context (ctx, &md);
+
+  mutt_buffer_pool_release (&buf);
+  mutt_buffer_pool_release (&path);
+
+  MonitorContextChanged = 0;
+
+  if (ngone)
+    return MUTT_REOPENED;
+  if (have_new)
+    return MUTT_NEW_MAIL;
+  if (flags_changed)
+    return MUTT_FLAGS;
+  return 0;
+}
+#endif /* USE_INOTIFY */
+
+
 /* This function handles arrival of new mail and reopening of
  * maildir folders.  The basic idea here is we check to see if either
  * the new or cur subdirectories have changed, and if so, we scan them
@@ -2220,6 +2707,7 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint)
   struct maildir **last, *p;
   int i;
   int count = 0;
+  int rescan = 0;		/* read both subdirectories regardless */
   HASH *fnames;			/* hash table for quickly looking up the base filename
 				   for a maildir message */
   struct mh_data *data = mh_data (ctx);
@@ -2230,6 +2718,11 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint)
   if (!option (OPTCHECKNEW))
     return 0;
 
+#ifdef USE_INOTIFY
+  if ((i = maildir_check_entries (ctx, index_hint, &rescan)) >= 0)
+    return i;
+#endif
+
   buf = mutt_buffer_pool_get ();
   mutt_buffer_printf (buf, "%s/new", ctx->path);
   if (stat (mutt_b2s (buf), &st_new) == -1)
@@ -2250,6 +2743,8 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint)
     changed = 1;
   if (mutt_stat_timespec_compare (&st_cur, MUTT_STAT_MTIME, &data->mtime_cur) > 0)
     changed |= 2;
+  if (rescan)
+    changed = 3;
 
   if (!changed)
   {
@@ -2282,6 +2777,8 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint)
     maildir_parse_dir (ctx, &last, "new", &count, NULL);
   if (changed & 2)
     maildir_parse_dir (ctx, &last, "cur", &count, NULL);
+  if (changed == 3)
+    data->reconciled = time (NULL);
 
   /* we create a hash table keyed off the canonical (sans flags) filename
    * of each message we scanned.  This is used in the loop over the
@@ -2307,26 +2804,8 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint)
       /* message already exists, merge flags */
       ctx->hdrs[i]->active = 1;
 
-      /* check to see if the message has moved to a different
-       * subdirectory.  If so, update the associated filename.
-       */
-      if (mutt_strcmp (ctx->hdrs[i]->path, p->h->path))
-	mutt_str_replace (&ctx->hdrs[i]->path, p->h->path);
-
-      /* if the user hasn't modified the flags on this message, update
-       * the flags we just detected.
-       */
-      if (!ctx->hdrs[i]->changed)
-	if (maildir_update_flags (ctx, ctx->hdrs[i], p->h))
-          flags_changed = 1;
-
-      if (ctx->hdrs[i]->deleted == ctx->hdrs[i]->trash)
-        if (ctx->hdrs[i]->deleted != p->h->deleted)
-        {
-          ctx->hdrs[i]->deleted = p->h->deleted;
-          flags_changed = 1;
-        }
-      ctx->hdrs[i]->trash = p->h->trash;
+      if (maildir_merge_header (ctx, ctx->hdrs[i], p->h))
+        flags_changed = 1;
 
       /* this is a duplicate of an existing header, so remove it */
       mutt_free_header (&p->h);
@@ -2359,7 +2838,10 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint)
 
   /* If we didn't just get new mail, update the tables. */
   if (occult)
+  {
+    hash_destroy (&data->canon_hash, NULL);
     maildir_update_tables (ctx, index_hint);
+  }
 
   /* do any delayed parsing we need to do. */
   maildir_delayed_parsing (ctx, &md, NULL);
@@ -2791,6 +3273,7 @@ struct mx_ops mx_maildir_ops = {
   .check = maildir_check_mailbox,
   .sync = mh_sync_mailbox,
   .save_to_header_cache = maildir_save_to_header_cache,
+  .link_msg = maildir_link_message,
 };
 
 struct mx_ops mx_mh_ops = {
@@ -2804,4 +3287,5 @@ struct mx_ops mx_mh_ops = {
   .check = mh_check_mailbox,
   .sync = mh_sync_mailbox,
   .save_to_header_cache = mh_save_to_header_cache,
+  .link_msg = mh_link_message,
 };
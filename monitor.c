@@ -46,6 +46,8 @@ typedef struct monitor_t
   ino_t st_ino;
   short magic;
   int descr;
+  BUFFY *buffy;		/* maildir whose counts are kept up to date */
+  short cur;		/* watching cur/ instead of new/ */
 }
 MONITOR;
 
@@ -56,11 +58,23 @@ static size_t PollFdsLen = 0;
 static struct pollfd *PollFds;
 
 static int MonitorContextDescriptor = -1;
+static int MonitorContextCurDescriptor = -1;
+
+/* Message files that appeared in or went away from the open maildir,
+ * for maildir_check_mailbox() to pick up. */
+static MONITOR_ENTRY *ContextEntries = NULL;
+static MONITOR_ENTRY **ContextEntriesTail = &ContextEntries;
+static int ContextEntriesCount = 0;
+static short ContextEntriesState = MUTT_MONITOR_ENTRIES_NEW;
+
+/* beyond this many, rereading the directories is cheaper */
+#define CONTEXT_ENTRIES_MAX 10000
 
 typedef struct monitorinfo_t
 {
   short magic;
   short isdir;
+  short cur;
   const char *path;
   dev_t st_dev;
   ino_t st_ino;
@@ -69,7 +83,10 @@ typedef struct monitorinfo_t
 }
 MONITORINFO;
 
-#define INOTIFY_MASK_DIR  (IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_ISDIR)
+#define INOTIFY_MASK_DIR  (IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_ISDIR | \
+                           INOTIFY_MASK_ENTRY)
+/* events that add or remove a message in a maildir subdirectory */
+#define INOTIFY_MASK_ENTRY (IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
 #define INOTIFY_MASK_FILE IN_CLOSE_WRITE
 
 static void mutt_poll_fd_add(int fd, short events)
@@ -150,6 +167,7 @@ static MONITOR *monitor_create (MONITORINFO *info, int descriptor)
   monitor->st_dev = info->st_dev;
   monitor->st_ino = info->st_ino;
   monitor->descr  = descriptor;
+  monitor->cur    = info->cur;
   monitor->next   = Monitor;
   if (info->magic == MUTT_MH)
     monitor->mh_backup_path = safe_strdup(info->path);
@@ -221,6 +239,8 @@ static int monitor_handle_ignore (int descr)
 
     if (MonitorContextDescriptor == descr)
       MonitorContextDescriptor = new_descr;
+    if (MonitorContextCurDescriptor == descr)
+      MonitorContextCurDescriptor = new_descr;
 
     if (new_descr == -1)
     {
@@ -232,8 +252,124 @@ static int monitor_handle_ignore (int descr)
   return new_descr;
 }
 
+void mutt_monitor_free_entries (MONITOR_ENTRY **entries)
+{
+  MONITOR_ENTRY *e;
+
+  while ((e = *entries) != NULL)
+  {
+    *entries = e->next;
+    FREE (&e->name);
+    FREE (&e);
+  }
+}
+
+static void monitor_reset_entries (short state)
+{
+  mutt_monitor_free_entries (&ContextEntries);
+  ContextEntriesTail = &ContextEntries;
+  ContextEntriesCount = 0;
+  ContextEntriesState = state;
+}
+
+/* a message appeared in or went away from a watched maildir subdirectory */
+static void monitor_handle_entry (const struct inotify_event *event)
+{
+  MONITOR *iter = Monitor;
+  MONITOR_ENTRY *e;
+
+  if (event->mask & IN_ISDIR)
+    return;
+
+  /* link() only raises IN_CREATE.  Maildir messages are never written
+   * in place, so a created file is complete already. */
+  if (((event->wd == MonitorContextDescriptor) ||
+       (event->wd == MonitorContextCurDescriptor)) &&
+      (ContextEntriesState != MUTT_MONITOR_ENTRIES_LOST))
+  {
+    if (ContextEntriesCount >= CONTEXT_ENTRIES_MAX)
+      monitor_reset_entries (MUTT_MONITOR_ENTRIES_LOST);
+    else
+    {
+      e = safe_calloc (1, sizeof (MONITOR_ENTRY));
+      e->name = safe_strdup (event->name);
+      e->cur = (event->wd == MonitorContextCurDescriptor);
+      e->added = (event->mask & (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO)) ? 1 : 0;
+      *ContextEntriesTail = e;
+      ContextEntriesTail = &e->next;
+      ContextEntriesCount++;
+    }
+  }
+
+  while (iter && iter->descr != event->wd)
+    iter = iter->next;
+
+  if (!iter || !iter->buffy || (event->mask & IN_CLOSE_WRITE))
+    return;
+
+  mutt_buffy_maildir_changed (iter->buffy, iter->cur, event->name,
+                              (event->mask & (IN_CREATE | IN_MOVED_TO)) ? 1 : 0);
+}
+
 #define EVENT_BUFLEN MAX(4096, sizeof(struct inotify_event) + NAME_MAX + 1)
 
+/* Reads and handles all queued inotify events, without waiting. */
+static void monitor_read_events (void)
+{
+  int len;
+  char *ptr;
+  const struct inotify_event *event;
+  char buf[EVENT_BUFLEN]
+    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+  FOREVER
+  {
+    len = read (INotifyFd, buf, sizeof(buf));
+    ptr = buf;
+    if (len == -1)
+    {
+      if (errno != EAGAIN)
+        dprint (2, (debugfile, "monitor: read inotify events failed, errno=%d %s\n",
+                    errno, strerror(errno)));
+      break;
+    }
+
+    while (ptr < buf + len)
+    {
+      event = (const struct inotify_event *) ptr;
+      dprint (5, (debugfile, "monitor:  + detail: descriptor=%d mask=0x%x\n",
+                  event->wd, event->mask));
+      if (event->mask & IN_IGNORED)
+        monitor_handle_ignore (event->wd);
+      else if (event->mask & IN_Q_OVERFLOW)
+      {
+        dprint (2, (debugfile, "monitor: event queue overflow\n"));
+        mutt_buffy_maildir_reset ();
+        monitor_reset_entries (MUTT_MONITOR_ENTRIES_LOST);
+        MonitorContextChanged = 1;
+      }
+      else
+      {
+        if ((event->wd == MonitorContextDescriptor) ||
+            (event->wd == MonitorContextCurDescriptor))
+          MonitorContextChanged = 1;
+        if (event->len && (event->mask & (INOTIFY_MASK_ENTRY | IN_CLOSE_WRITE)))
+          monitor_handle_entry (event);
+      }
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+}
+
+/* Applies the events queued so far.  The buffy maildir counts are kept
+ * current by them, so they must be applied before a directory is read:
+ * applied afterwards, they would count its changes a second time. */
+void mutt_monitor_drain (void)
+{
+  if (INotifyFd != -1)
+    monitor_read_events ();
+}
+
 /* mutt_monitor_poll: Waits for I/O ready file descriptors or signals.
  *
  * return values:
@@ -249,8 +385,6 @@ static int monitor_handle_ignore (int descr)
 int mutt_monitor_poll (void)
 {
   int rc = 0, fds, i, inputReady;
-  char buf[EVENT_BUFLEN]
-    __attribute__ ((aligned(__alignof__(struct inotify_event))));
 
   MonitorFilesChanged = 0;
 
@@ -282,33 +416,7 @@ int mutt_monitor_poll (void)
           {
             MonitorFilesChanged = 1;
             dprint (3, (debugfile, "monitor: file change(s) detected\n"));
-            int len;
-            char *ptr = buf;
-            const struct inotify_event *event;
-
-            FOREVER
-            {
-              len = read (INotifyFd, buf, sizeof(buf));
-              if (len == -1)
-              {
-                if (errno != EAGAIN)
-                  dprint (2, (debugfile, "monitor: read inotify events failed, errno=%d %s\n",
-                              errno, strerror(errno)));
-                break;
-              }
-
-              while (ptr < buf + len)
-              {
-                event = (const struct inotify_event *) ptr;
-                dprint (5, (debugfile, "monitor:  + detail: descriptor=%d mask=0x%x\n",
-                            event->wd, event->mask));
-                if (event->mask & IN_IGNORED)
-                  monitor_handle_ignore (event->wd);
-                else if (event->wd == MonitorContextDescriptor)
-                  MonitorContextChanged = 1;
-                ptr += sizeof(struct inotify_event) + event->len;
-              }
-            }
+            monitor_read_events ();
           }
         }
       }
@@ -327,6 +435,7 @@ int mutt_monitor_poll (void)
 #define RESOLVERES_FAIL_STAT      -1
 
 /* monitor_resolve: resolve monitor entry match by BUFFY, or - if NULL - by Context.
+ * For a maildir, new/ is watched, or cur/ if cur is set.
  *
  * return values:
  *      >=0   mailbox is valid and locally accessible:
@@ -335,7 +444,7 @@ int mutt_monitor_poll (void)
  *       -2   magic not set
  *       -1   stat() failed (see errno; MONITORINFO fields: magic, isdir, path)
  */
-static int monitor_resolve (MONITORINFO *info, BUFFY *buffy)
+static int monitor_resolve (MONITORINFO *info, BUFFY *buffy, short cur)
 {
   MONITOR *iter;
   char *fmt = NULL;
@@ -363,7 +472,8 @@ static int monitor_resolve (MONITORINFO *info, BUFFY *buffy)
   else if (info->magic == MUTT_MAILDIR)
   {
     info->isdir = 1;
-    fmt = "%s/new";
+    info->cur = cur;
+    fmt = cur ? "%s/cur" : "%s/new";
   }
   else
   {
@@ -393,13 +503,13 @@ static int monitor_resolve (MONITORINFO *info, BUFFY *buffy)
   return iter ? RESOLVERES_OK_EXISTING : RESOLVERES_OK_NOTEXISTING;
 }
 
-/* mutt_monitor_add: add file monitor from BUFFY, or - if NULL - from Context.
+/* monitor_add: add file monitor from BUFFY, or - if NULL - from Context.
  *
  * return values:
  *       0   success: new or already existing monitor
  *      -1   failed:  no mailbox, inaccessible file, create monitor/watcher failed
  */
-int mutt_monitor_add (BUFFY *buffy)
+static int monitor_add (BUFFY *buffy, short cur)
 {
   MONITORINFO info;
   uint32_t mask;
@@ -407,11 +517,18 @@ int mutt_monitor_add (BUFFY *buffy)
 
   monitor_info_init (&info);
 
-  descr = monitor_resolve (&info, buffy);
+  descr = monitor_resolve (&info, buffy, cur);
   if (descr != RESOLVERES_OK_NOTEXISTING)
   {
     if (!buffy && (descr == RESOLVERES_OK_EXISTING))
-      MonitorContextDescriptor = info.monitor->descr;
+    {
+      if (cur)
+        MonitorContextCurDescriptor = info.monitor->descr;
+      else
+        MonitorContextDescriptor = info.monitor->descr;
+    }
+    if (buffy && (descr == RESOLVERES_OK_EXISTING) && (info.magic == MUTT_MAILDIR))
+      info.monitor->buffy = buffy;
     rc = descr == RESOLVERES_OK_EXISTING ? 0 : -1;
     goto cleanup;
   }
@@ -427,23 +544,58 @@ int mutt_monitor_add (BUFFY *buffy)
 
   dprint (3, (debugfile, "monitor: inotify_add_watch descriptor=%d for '%s'\n", descr, info.path));
   if (!buffy)
-    MonitorContextDescriptor = descr;
+  {
+    if (cur)
+      MonitorContextCurDescriptor = descr;
+    else
+      MonitorContextDescriptor = descr;
+  }
 
   monitor_create (&info, descr);
+  if (buffy && (info.magic == MUTT_MAILDIR))
+    Monitor->buffy = buffy;
 
 cleanup:
   monitor_info_free (&info);
   return rc;
 }
 
-/* mutt_monitor_remove: remove file monitor from BUFFY, or - if NULL - from Context.
+/* mutt_monitor_add: add file monitor from BUFFY, or - if NULL - from Context.
+ * For a maildir, cur/ is watched as well: to keep a BUFFY's counts current,
+ * and to queue the Context's changes for maildir_check_mailbox().
+ *
+ * return values:
+ *       0   success: new or already existing monitor
+ *      -1   failed:  no mailbox, inaccessible file, create monitor/watcher failed
+ */
+int mutt_monitor_add (BUFFY *buffy)
+{
+  int rc;
+
+  rc = monitor_add (buffy, 0);
+  if (!rc)
+  {
+    if (buffy && (buffy->magic == MUTT_MAILDIR))
+      monitor_add (buffy, 1);
+    else if (!buffy && Context && (Context->magic == MUTT_MAILDIR))
+      monitor_add (NULL, 1);
+  }
+
+  /* what happened before the watches were set up isn't known */
+  if (!buffy)
+    monitor_reset_entries (MUTT_MONITOR_ENTRIES_NEW);
+
+  return rc;
+}
+
+/* monitor_remove: remove file monitor from BUFFY, or - if NULL - from Context.
  *
  * return values:
  *       0   monitor removed (not shared)
  *       1   monitor not removed (shared)
  *       2   no monitor
  */
-int mutt_monitor_remove (BUFFY *buffy)
+static int monitor_remove (BUFFY *buffy, short cur)
 {
   MONITORINFO info, info2;
   int rc = 0;
@@ -453,11 +605,14 @@ int mutt_monitor_remove (BUFFY *buffy)
 
   if (!buffy)
   {
-    MonitorContextDescriptor = -1;
+    if (cur)
+      MonitorContextCurDescriptor = -1;
+    else
+      MonitorContextDescriptor = -1;
     MonitorContextChanged = 0;
   }
 
-  if (monitor_resolve (&info, buffy) != RESOLVERES_OK_EXISTING)
+  if (monitor_resolve (&info, buffy, cur) != RESOLVERES_OK_EXISTING)
   {
     rc = 2;
     goto cleanup;
@@ -467,7 +622,7 @@ int mutt_monitor_remove (BUFFY *buffy)
   {
     if (buffy)
     {
-      if (monitor_resolve (&info2, NULL) == RESOLVERES_OK_EXISTING
+      if (monitor_resolve (&info2, NULL, cur) == RESOLVERES_OK_EXISTING
           && info.st_ino == info2.st_ino && info.st_dev == info2.st_dev)
       {
         rc = 1;
@@ -495,3 +650,61 @@ cleanup:
   monitor_info_free (&info2);
   return rc;
 }
+
+/* mutt_monitor_remove: remove file monitor from BUFFY, or - if NULL - from Context.
+ *
+ * return values:
+ *       0   monitor removed (not shared)
+ *       1   monitor not removed (shared)
+ *       2   no monitor
+ */
+int mutt_monitor_remove (BUFFY *buffy)
+{
+  MONITOR *iter;
+
+  /* the BUFFY is going away, even if its monitors can't be resolved */
+  for (iter = Monitor; iter; iter = iter->next)
+    if (buffy && (iter->buffy == buffy))
+      iter->buffy = NULL;
+
+  if (buffy ? (buffy->magic == MUTT_MAILDIR) :
+      (Context && (Context->magic == MUTT_MAILDIR)))
+    monitor_remove (buffy, 1);
+
+  if (!buffy)
+    monitor_reset_entries (MUTT_MONITOR_ENTRIES_NEW);
+
+  return monitor_remove (buffy, 0);
+}
+
+/* mutt_monitor_context_entries: hand over the message files that appeared
+ * in or went away from the open maildir since the last call, oldest first.
+ *
+ * return values:
+ *       0   *entries is everything that happened (maybe nothing)
+ *      -1   events were lost: the directories have to be read again
+ *      -2   not watched, or not since the last check: compare mtimes
+ */
+int mutt_monitor_context_entries (MONITOR_ENTRY **entries)
+{
+  int rc;
+
+  *entries = ContextEntries;
+  ContextEntries = NULL;
+
+  if ((MonitorContextDescriptor == -1) || (MonitorContextCurDescriptor == -1))
+    rc = -2;
+  else if (ContextEntriesState == MUTT_MONITOR_ENTRIES_LOST)
+    rc = -1;
+  else if (ContextEntriesState == MUTT_MONITOR_ENTRIES_NEW)
+    rc = -2;
+  else
+    rc = 0;
+
+  if (rc)
+    mutt_monitor_free_entries (entries);
+
+  monitor_reset_entries (MUTT_MONITOR_ENTRIES_OK);
+  return rc;
+}
+
@@ -27,5 +27,23 @@ int mutt_monitor_add (BUFFY *b);
 int mutt_monitor_remove (BUFFY *b);
 #endif
 int mutt_monitor_poll (void);
+void mutt_monitor_drain (void);
+
+/* a message file that appeared in or went away from the open maildir */
+typedef struct monitor_entry_t
+{
+  struct monitor_entry_t *next;
+  char *name;
+  short cur;			/* in cur/ rather than new/ */
+  short added;
+}
+MONITOR_ENTRY;
+
+#define MUTT_MONITOR_ENTRIES_OK   0
+#define MUTT_MONITOR_ENTRIES_NEW  1	/* watching only just started */
+#define MUTT_MONITOR_ENTRIES_LOST 2	/* some were dropped */
+
+int mutt_monitor_context_entries (MONITOR_ENTRY **entries);
+void mutt_monitor_free_entries (MONITOR_ENTRY **entries);
 
 #endif /* MONITOR_H */
@@ -475,6 +475,7 @@ enum
   OPTMAILDIRCHECKCUR,
   OPTMARKERS,
   OPTMARKOLD,
+  OPTMBOXPADSTATUS,
   OPTMENUSCROLL,	/* scroll menu instead of implicit next-page */
   OPTMENUMOVEOFF,	/* allow menu to scroll past last entry */
 #if defined(USE_IMAP) || defined(USE_POP)
@@ -892,6 +893,9 @@ typedef struct header
   short recipient;		/* user_is_recipient()'s return value, cached */
 
   int pair; 			/* color-pair to use when displaying in the index */
+  unsigned long color_gen;	/* ColorIndexGen the bits below belong to */
+  unsigned long color_known;	/* stable color index rules already tried */
+  unsigned long color_matched;	/* ...and which of them matched */
 
   time_t date_sent;     	/* time when the message was sent (UTC) */
   time_t received;      	/* time when the message was placed in the mailbox */
@@ -908,6 +912,9 @@ typedef struct header
   char *tree;           	/* character string to print thread tree */
   THREAD *thread;
 
+  struct index_row *index_row;	/* cached index line, see index_make_entry() */
+  unsigned long gen;		/* bumped when its flags or headers change */
+
   /* Number of qualifying attachments in message, if attach_valid */
   short attach_total;
 
@@ -977,6 +984,7 @@ typedef struct pattern_t
   unsigned int ign_case : 1;		/* ignore case for local stringmatch searches */
   unsigned int isalias : 1;
   unsigned int dynamic : 1;  /* evaluate date ranges at run time */
+  unsigned int relative : 1; /* date range depends on the current time */
   unsigned int sendmode : 1; /* evaluate searches in send-mode */
   int min;
   int max;
@@ -1037,6 +1045,7 @@ struct _message;
  *
  * Optional operations
  *  - open_new_msg
+ *  - link_msg
  */
 struct mx_ops
 {
@@ -1051,8 +1060,20 @@ struct mx_ops
   int (*open_new_msg) (struct _message *, struct _context *, HEADER *);
   int (*msg_padding_size) (struct _context *);
   int (*save_to_header_cache) (struct _context *, struct header *);
+  int (*link_msg) (struct _context *dest, struct _context *src, struct header *);
 };
 
+/* result of a limit pattern, remembered so that switching back to it
+ * doesn't require evaluating it again.  See mutt_pattern_func(). */
+typedef struct limit_cache
+{
+  char *pattern;                /* expanded limit pattern */
+  unsigned char *matched;       /* matching messages, by HEADER->index */
+  int msgcount;                 /* number of messages evaluated */
+  unsigned long gen;            /* value of ctx->gen when evaluated */
+  struct limit_cache *next;
+} LIMIT_CACHE;
+
 typedef struct _context
 {
   char *path;
@@ -1064,6 +1085,8 @@ typedef struct _context
   off_t vsize;
   char *pattern;                /* limit pattern string */
   pattern_t *limit_pattern;     /* compiled limit pattern */
+  LIMIT_CACHE *limit_cache;     /* most recent limit results first */
+  unsigned long gen;            /* bumped when message flags or headers change */
   HEADER **hdrs;
   HEADER *last_tag;		/* last tagged msg. used to link threads */
   THREAD *tree;			/* top of thread tree */
@@ -91,6 +91,7 @@ extern int MuttGetchTimeout;
 event_t mutt_getch (void);
 
 void mutt_getch_timeout (int);
+int mutt_idle (int);
 void mutt_endwin (const char *);
 void mutt_flushinp (void);
 void mutt_refresh (void);
@@ -157,6 +158,19 @@ typedef struct color_line
   unsigned int stop_matching : 1; /* used by the pager for body patterns,
                                      to prevent the color from being retried
                                      once it fails. */
+  unsigned int stable : 1;        /* color_pattern results can be cached per
+                                     header, see mutt_set_header_color() */
+
+  /* regexp analysis used by the pager to skip hopeless regexec() calls */
+  char *literal;                  /* ASCII text every match contains */
+  unsigned int icase : 1;         /* rx ignores case */
+  unsigned int is_literal : 1;    /* rx matches exactly literal */
+  unsigned int context_free : 1;  /* rx has no anchors or word boundaries */
+
+  /* the pager's first match of rx in the current line, valid if
+   * match_valid is set */
+  regmatch_t match;
+  unsigned int match_valid : 1;
 } COLOR_LINE;
 
 #define MUTT_PROGRESS_SIZE      (1<<0)  /* traffic-based progress */
@@ -41,6 +41,15 @@
 
 #define MUTT_MODEFMT "-- Mutt: %s"
 
+/* what menu_redraw_index() last put on a row of the index window */
+struct menu_row_t
+{
+  char *text;			/* NULL if unknown */
+  int attr;
+  int current;			/* drawn with the indicator */
+  int blank;			/* cleared: past the last entry */
+};
+
 typedef struct menu_t
 {
   char *title;   /* the title of this menu */
@@ -90,6 +99,12 @@ typedef struct menu_t
   int oldcurrent;	/* for driver use only. */
   int searchDir;	/* direction of search */
   int tagged;		/* number of tagged entries */
+
+  /* rows as last drawn, so that unchanged ones aren't sent again */
+  struct menu_row_t *rows;
+  int rowslen;
+  unsigned long rows_gen;	/* IndexRowGen when rows were drawn */
+  unsigned long rows_screen;	/* ScreenClearGen, likewise */
 } MUTTMENU;
 
 void mutt_menu_init (void);
@@ -371,6 +371,7 @@ HEADER *mutt_dup_header(HEADER *h)
 
   hnew = mutt_new_header();
   memcpy(hnew, h, sizeof (HEADER));
+  hnew->index_row = NULL;
   return hnew;
 }
 
@@ -381,6 +382,7 @@ void mutt_free_header (HEADER **h)
   mutt_free_body (&(*h)->content);
   FREE (&(*h)->maildir_flags);
   FREE (&(*h)->tree);
+  FREE (&(*h)->index_row);
   FREE (&(*h)->path);
 #ifdef MIXMASTER
   mutt_free_list (&(*h)->chain);
@@ -29,6 +29,7 @@
 #include "copy.h"
 #include "keymap.h"
 #include "url.h"
+#include "mutt_curses.h"
 #ifdef USE_SIDEBAR
 #include "sidebar.h"
 #endif
@@ -39,6 +40,9 @@
 
 #ifdef USE_IMAP
 #include "imap.h"
+#ifdef USE_HCACHE
+#include "imap_private.h"
+#endif
 #endif
 
 #ifdef USE_POP
@@ -93,6 +97,46 @@ struct mx_ops* mx_get_ops (int magic)
   }
 }
 
+#ifdef USE_HCACHE
+/* Opens the header cache of ctx's folder, for entries describing the
+ * folder as a whole rather than a single message.  Returns NULL if the
+ * folder type doesn't keep one.  Release it with mx_hcache_close(). */
+header_cache_t *mx_hcache_open (CONTEXT *ctx)
+{
+  if (!ctx || !HeaderCache)
+    return NULL;
+
+  switch (ctx->magic)
+  {
+#ifdef USE_IMAP
+    case MUTT_IMAP:
+    {
+      IMAP_DATA *idata = (IMAP_DATA *) ctx->data;
+
+      /* the handle may already be open while fetching headers */
+      if (idata->hcache)
+        return idata->hcache;
+      return imap_hcache_open (idata, NULL);
+    }
+#endif
+    case MUTT_MAILDIR:
+    case MUTT_MH:
+      return mutt_hcache_open (HeaderCache, ctx->path, NULL);
+    default:
+      return NULL;
+  }
+}
+
+void mx_hcache_close (CONTEXT *ctx, header_cache_t *hc)
+{
+#ifdef USE_IMAP
+  if (ctx->magic == MUTT_IMAP && hc == ((IMAP_DATA *) ctx->data)->hcache)
+    return;
+#endif
+  mutt_hcache_close (hc);
+}
+#endif
+
 #define mutt_is_spool(s)  (mutt_strcmp (Spoolfile, s) == 0)
 
 #ifdef USE_DOTLOCK
@@ -315,6 +359,120 @@ int mx_unlock_file (const char *path, int fd, int dot)
   return 0;
 }
 
+/* The files and directories written to since the outermost
+ * mx_fsync_begin(), for mx_fsync_end() to sync when $fsync_mode is
+ * "batch". */
+static HASH *FsyncFiles = NULL;
+static HASH *FsyncDirs = NULL;
+static int FsyncDepth = 0;
+
+static int mx_fsync_deferred (CONTEXT *ctx)
+{
+#ifdef USE_COMPRESSED
+  /* the plaintext copy of a compressed folder is gone by the end */
+  if (ctx->compress_info)
+    return 0;
+#endif
+  return FsyncDepth && FsyncMode == MUTT_FSYNC_BATCH;
+}
+
+/* Starts a batch of messages written to local mailboxes.  Until the
+ * matching mx_fsync_end(), with $fsync_mode "batch", they are only
+ * synced to disk at its end.  Batches nest. */
+void mx_fsync_begin (void)
+{
+  if (FsyncDepth++)
+    return;
+
+  FsyncFiles = hash_create (64, MUTT_HASH_STRDUP_KEYS);
+  FsyncDirs = hash_create (16, MUTT_HASH_STRDUP_KEYS);
+}
+
+static int mx_fsync_path (const char *path)
+{
+  int fd, rc;
+
+  if ((fd = open (path, O_RDONLY)) == -1)
+    return -1;
+  rc = fsync (fd);
+  close (fd);
+  return rc;
+}
+
+/* Ends a batch: syncs what was written during it in one pass, files
+ * before the directories naming them.
+ * Returns 0 on success, -1 if anything couldn't be synced. */
+int mx_fsync_end (void)
+{
+  HASH *table[2];
+  struct hash_walk_state state;
+  struct hash_elem *elem;
+  int i, count = 0, rc = 0;
+
+  if (!FsyncDepth || --FsyncDepth)
+    return 0;
+
+  table[0] = FsyncFiles;
+  table[1] = FsyncDirs;
+  for (i = 0; i < 2; i++)
+  {
+    memset (&state, 0, sizeof (state));
+    while ((elem = hash_walk (table[i], &state)) != NULL)
+    {
+      if (mx_fsync_path (elem->key.strkey) != 0)
+      {
+        mutt_perror (elem->key.strkey);
+        rc = -1;
+      }
+      count++;
+    }
+  }
+
+  dprint (2, (debugfile, "mx_fsync_end: synced %d files and directories\n", count));
+
+  hash_destroy (&FsyncFiles, NULL);
+  hash_destroy (&FsyncDirs, NULL);
+  return rc;
+}
+
+/* Flushes a message written to ctx, and syncs it to disk unless
+ * $fsync_mode defers that to the end of the batch, or turns it off.
+ * Returns 0 on success, -1 on error. */
+int mx_fsync_stream (CONTEXT *ctx, FILE *fp)
+{
+  if (fflush (fp) == EOF)
+    return -1;
+
+  if (mx_fsync_deferred (ctx) || FsyncMode == MUTT_FSYNC_NONE)
+    return 0;
+
+  return fsync (fileno (fp));
+}
+
+/* Notes the file a message written to ctx ended up in for
+ * mx_fsync_end(), along with the directory naming it if it was just
+ * created there. */
+void mx_fsync_defer (CONTEXT *ctx, const char *path, int dir)
+{
+  BUFFER *parent;
+  char *p;
+
+  if (!mx_fsync_deferred (ctx))
+    return;
+
+  if (!hash_find_elem (FsyncFiles, path))
+    hash_insert (FsyncFiles, path, NULL);
+
+  if (dir && (p = strrchr (path, '/')) != NULL)
+  {
+    parent = mutt_buffer_pool_get ();
+    mutt_buffer_addstr_n (parent, path, p - path);
+    if (!hash_find_elem (FsyncDirs, mutt_b2s (parent)))
+      hash_insert (FsyncDirs, mutt_b2s (parent), NULL);
+    mutt_buffer_pool_release (&parent);
+  }
+}
+
 static void mx_unlink_empty (const char *path)
 {
   int fd;
@@ -734,6 +892,7 @@ void mx_fastclose_mailbox (CONTEXT *ctx)
   FREE (&ctx->pattern);
   if (ctx->limit_pattern)
     mutt_pattern_free (&ctx->limit_pattern);
+  mutt_limit_cache_free (&ctx->limit_cache);
   safe_fclose (&ctx->fp);
   memset (ctx, 0, sizeof (CONTEXT));
 }
@@ -766,7 +925,7 @@ static int sync_mailbox (CONTEXT *ctx, int *index_hint)
 static int trash_append (CONTEXT *ctx)
 {
   CONTEXT ctx_trash;
-  int i;
+  int i, count = 0;
   struct stat st, stc;
   int opt_confappend, rc;
 
@@ -776,8 +935,8 @@ static int trash_append (CONTEXT *ctx)
 
   for (i = 0; i < ctx->msgcount; i++)
     if (ctx->hdrs[i]->deleted  && (!ctx->hdrs[i]->purge))
-      break;
-  if (i == ctx->msgcount)
+      count++;
+  if (!count)
     return 0; /* nothing to be done */
 
   /* avoid the "append messages" prompt */
@@ -805,26 +964,25 @@ static int trash_append (CONTEXT *ctx)
   }
 #endif
 
-  if (mx_open_mailbox (TrashPath, MUTT_APPEND, &ctx_trash) != NULL)
+  if (mx_append_begin (TrashPath, &ctx_trash, count) != 0)
   {
-    /* continue from initial scan above */
-    for (; i < ctx->msgcount ; i++)
-      if (ctx->hdrs[i]->deleted  && (!ctx->hdrs[i]->purge))
+    mutt_error _("Can't open trash folder");
+    return -1;
+  }
+
+  for (i = 0; i < ctx->msgcount ; i++)
+    if (ctx->hdrs[i]->deleted  && (!ctx->hdrs[i]->purge))
+    {
+      if (mx_append_message (&ctx_trash, ctx, ctx->hdrs[i], 0, 0, 1) == -1)
       {
-        if (mutt_append_message (&ctx_trash, ctx, ctx->hdrs[i], 0, 0) == -1)
-        {
-          mx_close_mailbox (&ctx_trash, NULL);
-          return -1;
-        }
+        mx_append_end (&ctx_trash);
+        return -1;
       }
+    }
 
-    mx_close_mailbox (&ctx_trash, NULL);
-  }
-  else
-  {
-    mutt_error _("Can't open trash folder");
+  /* the originals are purged next, so the copies must be on disk */
+  if (mx_append_end (&ctx_trash) != 0)
     return -1;
-  }
 
   return 0;
 }
@@ -958,7 +1116,7 @@ int mx_close_mailbox (CONTEXT *ctx, int *index_hint)
     else /* use regular append-copy mode */
 #endif
     {
-      if (mx_open_mailbox (mutt_b2s (mbox), MUTT_APPEND, &f) == NULL)
+      if (mx_append_begin (mutt_b2s (mbox), &f, read_msgs) != 0)
       {
 	ctx->closing = 0;
 	goto cleanup;
@@ -969,21 +1127,26 @@ int mx_close_mailbox (CONTEXT *ctx, int *index_hint)
 	if (ctx->hdrs[i]->read && !ctx->hdrs[i]->deleted
             && !(ctx->hdrs[i]->flagged && option (OPTKEEPFLAGGED)))
         {
-	  if (mutt_append_message (&f, ctx, ctx->hdrs[i], 0, CH_UPDATE_LEN) == 0)
+	  if (mx_append_message (&f, ctx, ctx->hdrs[i], 0, CH_UPDATE_LEN, 1) == 0)
 	  {
 	    mutt_set_flag (ctx, ctx->hdrs[i], MUTT_DELETE, 1);
 	    mutt_set_flag (ctx, ctx->hdrs[i], MUTT_PURGE, 1);
 	  }
 	  else
 	  {
-	    mx_close_mailbox (&f, NULL);
+	    mx_append_end (&f);
 	    ctx->closing = 0;
 	    goto cleanup;
 	  }
 	}
       }
 
-      mx_close_mailbox (&f, NULL);
+      /* the moved messages are purged below */
+      if (mx_append_end (&f) != 0)
+      {
+        ctx->closing = 0;
+        goto cleanup;
+      }
     }
 
   }
@@ -1092,6 +1255,9 @@ void mx_update_tables(CONTEXT *ctx, int committing)
 {
   int i, j, padding;
 
+  /* messages are renumbered below */
+  ctx->gen++;
+
   /* update memory to reflect the new state of the mailbox */
   ctx->vcount = 0;
   ctx->vsize = 0;
@@ -1369,13 +1535,24 @@ MESSAGE *mx_open_new_message (CONTEXT *dest, HEADER *hdr, int flags)
 /* check for new mail */
 int mx_check_mailbox (CONTEXT *ctx, int *index_hint)
 {
+  int rc;
+
   if (!ctx || !ctx->mx_ops)
   {
     dprint (1, (debugfile, "mx_check_mailbox: null or invalid context.\n"));
     return -1;
   }
 
-  return ctx->mx_ops->check (ctx, index_hint);
+  rc = ctx->mx_ops->check (ctx, index_hint);
+  /* new mail alone leaves the existing messages untouched.  Otherwise
+   * any of them may have changed, without going through mutt_set_flag(). */
+  if (rc == MUTT_REOPENED || rc == MUTT_FLAGS)
+  {
+    ctx->gen++;
+    IndexRowGen++;
+  }
+
+  return rc;
 }
 
 /* return a stream pointer for a message */
@@ -1593,4 +1770,88 @@ int mx_save_to_header_cache (CONTEXT *ctx, HEADER *h)
   return ctx->mx_ops->save_to_header_cache (ctx, h);
 }
 
+/* Moves a message of a local maildir or MH folder into dest by linking
+ * its file rather than copying it.  Only messages that would be copied
+ * unchanged qualify, and the original is left for the source folder to
+ * purge.
+ *
+ * Returns 0 on success, 1 if the message has to be copied instead, or
+ * -1 on error.
+ */
+static int mx_link_message (CONTEXT *dest, CONTEXT *src, HEADER *hdr)
+{
+  if (!dest->mx_ops || !dest->mx_ops->link_msg)
+    return 1;
+
+  if (src->magic != MUTT_MAILDIR && src->magic != MUTT_MH)
+    return 1;
+
+  /* mutt_copy_message() would rewrite these */
+  if (hdr->attach_del || (hdr->env && hdr->env->changed))
+    return 1;
+
+  return dest->mx_ops->link_msg (dest, src, hdr);
+}
+
+/*
+ * A batch of messages is appended to a mailbox that is opened, and
+ * locked, only once.  The messages share a progress bar and, with
+ * $fsync_mode=batch, are synced together at the end.
+ */
+
+static progress_t AppendProgress;
+static int AppendCount = 0;
+static int AppendDone;
+
+/* Opens path to append count messages to.  Returns 0 on success. */
+int mx_append_begin (const char *path, CONTEXT *dest, int count)
+{
+  mx_fsync_begin ();
+
+  if (mx_open_mailbox (path, MUTT_APPEND, dest) == NULL)
+  {
+    mx_fsync_end ();
+    return -1;
+  }
+
+  AppendCount = count;
+  AppendDone = 0;
+  if (AppendCount > 1)
+    mutt_progress_init (&AppendProgress, _("Copying messages..."),
+                        MUTT_PROGRESS_MSG, WriteInc, AppendCount);
+
+  return 0;
+}
+
+/* Appends a message of src to dest.  A message that is moved (move is
+ * set) without being decoded may just be linked into dest.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int mx_append_message (CONTEXT *dest, CONTEXT *src, HEADER *hdr,
+                       int cmflags, int chflags, int move)
+{
+  int rc = 1;
+
+  if (move && !cmflags)
+    rc = mx_link_message (dest, src, hdr);
+  if (rc == 1)
+    rc = mutt_append_message (dest, src, hdr, cmflags, chflags);
+
+  if (rc == 0 && AppendCount > 1)
+    mutt_progress_update (&AppendProgress, ++AppendDone, -1);
+
+  return rc;
+}
+
+/* Closes a mailbox opened by mx_append_begin().  Returns -1 if the
+ * messages couldn't be synced to disk. */
+int mx_append_end (CONTEXT *dest)
+{
+  AppendCount = 0;
+  mx_close_mailbox (dest, NULL);
+
+  return mx_fsync_end ();
+}
+
 /* vim: set sw=2: */
@@ -28,6 +28,10 @@
 #include "mailbox.h"
 #include "buffy.h"
 
+#ifdef USE_HCACHE
+#include "hcache.h"
+#endif
+
 /* supported mailbox formats */
 enum
 {
@@ -71,7 +75,25 @@ void mx_update_tables (CONTEXT *, int);
 int mx_lock_file (const char *, int, int, int, int);
 int mx_unlock_file (const char *path, int fd, int dot);
 
+/* $fsync_mode */
+enum
+{
+  MUTT_FSYNC_MESSAGE = 0,
+  MUTT_FSYNC_BATCH,
+  MUTT_FSYNC_NONE
+};
+
+void mx_fsync_begin (void);
+int mx_fsync_end (void);
+int mx_fsync_stream (CONTEXT *, FILE *);
+void mx_fsync_defer (CONTEXT *, const char *, int);
+
 struct mx_ops* mx_get_ops (int magic);
+
+#ifdef USE_HCACHE
+header_cache_t *mx_hcache_open (CONTEXT *);
+void mx_hcache_close (CONTEXT *, header_cache_t *);
+#endif
 extern struct mx_ops mx_maildir_ops;
 extern struct mx_ops mx_mbox_ops;
 extern struct mx_ops mx_mh_ops;
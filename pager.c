@@ -38,6 +38,9 @@
 #include "mutt_crypt.h"
 
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <ctype.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -103,6 +106,17 @@ struct q_class_t
   struct q_class_t *down, *up;
 };
 
+/* Index of the known quote prefixes, one node per prefix byte, so that
+ * the class of an already seen prefix is found without walking the
+ * class tree. */
+struct q_trie_t
+{
+  unsigned char ch;
+  struct q_class_t *class;	/* class whose prefix ends here, if any */
+  struct q_trie_t *down;	/* nodes for the following byte */
+  struct q_trie_t *next;	/* other nodes for this byte */
+};
+
 struct syntax_t
 {
   int color;
@@ -123,6 +137,34 @@ struct line_t
   unsigned int is_cont_hdr; /* this line is a continuation of the previous header line */
 };
 
+/* The header or body pattern matches of one line of the file.  They
+ * don't depend on the window width, so they are kept across a reflow.
+ */
+struct syntax_cache_t
+{
+  LOFF_T offset;
+  short hdr;			/* matched against the header patterns */
+  short chunks;
+  struct syntax_t *syntax;
+};
+
+/* The file being paged.  Where possible it is mapped into memory, so
+ * that jumping around a large message doesn't turn into a seek and a
+ * stdio refill for every line we look at. */
+struct pager_file
+{
+  FILE *fp;
+  LOFF_T last_pos;
+  unsigned char *map;
+  LOFF_T size;
+
+  struct syntax_cache_t *syntax_cache;	/* sorted by offset */
+  int syntax_cached;
+  int syntax_max;
+  unsigned long syntax_gen;	/* ColorBodyGen when the cache was filled */
+  int syntax_partial;		/* $header_color_partial, likewise */
+};
+
 #define ANSI_OFF       (1<<0)
 #define ANSI_BLINK     (1<<1)
 #define ANSI_BOLD      (1<<2)
@@ -397,29 +439,65 @@ cleanup_quote (struct q_class_t **QuoteList)
   return;
 }
 
-static struct q_class_t *
-classify_quote (struct q_class_t **QuoteList, const char *qptr,
-		int length, int *force_redraw, int *q_level)
+static void
+cleanup_quote_trie (struct q_trie_t **QuoteTrie)
 {
-  struct q_class_t *q_list = *QuoteList;
-  struct q_class_t *class = NULL, *tmp = NULL, *ptr, *save;
-  char *tail_qptr;
-  int offset, tail_lng;
-  int index = -1;
+  struct q_trie_t *ptr;
 
-  if (ColorQuoteUsed <= 1)
+  while (*QuoteTrie)
   {
-    /* not much point in classifying quotes... */
+    if ((*QuoteTrie)->down)
+      cleanup_quote_trie (&((*QuoteTrie)->down));
+    ptr = (*QuoteTrie)->next;
+    FREE (QuoteTrie);		/* __FREE_CHECKED__ */
+    *QuoteTrie = ptr;
+  }
+}
 
-    if (*QuoteList == NULL)
+/* Returns the trie node for the given prefix, adding the missing nodes
+ * if create is set.  Returns NULL if the prefix isn't there.
+ */
+static struct q_trie_t *
+quote_trie_node (struct q_trie_t **QuoteTrie, const char *qptr, int length,
+		 int create)
+{
+  struct q_trie_t *node = NULL;
+  int i;
+
+  for (i = 0; i < length; i++)
+  {
+    for (node = *QuoteTrie;
+	 node && node->ch != (unsigned char) qptr[i];
+	 node = node->next)
+      ;
+    if (node == NULL)
     {
-      class = (struct q_class_t *) safe_calloc (1, sizeof (struct q_class_t));
-      class->color = ColorQuote[0];
-      *QuoteList = class;
+      if (!create)
+	return NULL;
+      node = (struct q_trie_t *) safe_calloc (1, sizeof (struct q_trie_t));
+      node->ch = (unsigned char) qptr[i];
+      node->next = *QuoteTrie;
+      *QuoteTrie = node;
     }
-    return (*QuoteList);
+    QuoteTrie = &node->down;
   }
 
+  return node;
+}
+
+/* Adds a new quoting prefix to the class tree, reparenting and
+ * renumbering the existing classes as needed.
+ */
+static struct q_class_t *
+insert_quote_class (struct q_class_t **QuoteList, const char *qptr,
+		    int length, int *force_redraw, int *q_level)
+{
+  struct q_class_t *q_list = *QuoteList;
+  struct q_class_t *class = NULL, *tmp = NULL, *ptr, *save;
+  char *tail_qptr;
+  int offset, tail_lng;
+  int index = -1;
+
   /* Did I mention how much I like emulating Lisp in C? */
 
   /* classify quoting prefix */
@@ -708,6 +786,42 @@ classify_quote (struct q_class_t **QuoteList, const char *qptr,
   return class;
 }
 
+static struct q_class_t *
+classify_quote (struct q_class_t **QuoteList, struct q_trie_t **QuoteTrie,
+		const char *qptr, int length, int *force_redraw, int *q_level)
+{
+  struct q_class_t *class;
+  struct q_trie_t *node;
+
+  if (ColorQuoteUsed <= 1)
+  {
+    /* not much point in classifying quotes... */
+
+    if (*QuoteList == NULL)
+    {
+      class = (struct q_class_t *) safe_calloc (1, sizeof (struct q_class_t));
+      class->color = ColorQuote[0];
+      *QuoteList = class;
+    }
+    return (*QuoteList);
+  }
+
+  if (length <= 0)
+    return insert_quote_class (QuoteList, qptr, length, force_redraw, q_level);
+
+  /* Classes are never removed and keep their prefix when the tree is
+   * reorganized, so a prefix seen before maps to the same class; only
+   * its color may have changed since, and that is kept in the class.
+   */
+  if ((node = quote_trie_node (QuoteTrie, qptr, length, 0)) && node->class)
+    return node->class;
+
+  class = insert_quote_class (QuoteList, qptr, length, force_redraw, q_level);
+  quote_trie_node (QuoteTrie, qptr, length, 1)->class = class;
+
+  return class;
+}
+
 static int brailleLine = -1;
 static int brailleCol = -1;
 
@@ -752,14 +866,162 @@ mutt_is_quote_line (char *buf, regmatch_t *pmatch)
   return is_quote;
 }
 
+/* the literal prefilters of color rules are only exact on ASCII text,
+ * where case folding is unambiguous */
+static int is_ascii (const char *s)
+{
+  for (; *s; s++)
+    if ((unsigned char) *s >= 0x80)
+      return 0;
+  return 1;
+}
+
+/* returns 1 if color_line's regexp can't match s, judging by its literal */
+static int color_line_excluded (COLOR_LINE *color_line, const char *s, int ascii)
+{
+  if (!ascii || !color_line->literal)
+    return 0;
+  if (color_line->icase)
+    return mutt_stristr (s, color_line->literal) == NULL;
+  return strstr (s, color_line->literal) == NULL;
+}
+
+/* Works like regexec() of color_line->rx on buf + offset.  A match found
+ * from an earlier offset that still lies ahead is reused, as long as the
+ * regexp doesn't look at the text before where matching starts, and the
+ * regexp is only run when its literal occurs in the rest of the line. */
+static int color_line_regexec (COLOR_LINE *color_line, const char *buf,
+                               int offset, int ascii, regmatch_t *pmatch)
+{
+  const char *p;
+
+  if (color_line->match_valid && color_line->match.rm_so >= offset)
+  {
+    pmatch->rm_so = color_line->match.rm_so - offset;
+    pmatch->rm_eo = color_line->match.rm_eo - offset;
+    return 0;
+  }
+  color_line->match_valid = 0;
+
+  if (color_line_excluded (color_line, buf + offset, ascii))
+    return REG_NOMATCH;
+
+  if (ascii && color_line->is_literal)
+  {
+    p = color_line->icase ? mutt_stristr (buf + offset, color_line->literal)
+                          : strstr (buf + offset, color_line->literal);
+    pmatch->rm_so = p - (buf + offset);
+    pmatch->rm_eo = pmatch->rm_so + mutt_strlen (color_line->literal);
+  }
+  else if (regexec (&color_line->rx, buf + offset, 1, pmatch,
+                    (offset ? REG_NOTBOL : 0)) != 0)
+    return REG_NOMATCH;
+
+  if (color_line->context_free)
+  {
+    color_line->match.rm_so = pmatch->rm_so + offset;
+    color_line->match.rm_eo = pmatch->rm_eo + offset;
+    color_line->match_valid = 1;
+  }
+  return 0;
+}
+
+static void syntax_cache_free (struct pager_file *pf)
+{
+  int i;
+
+  for (i = 0; i < pf->syntax_cached; i++)
+    FREE (&pf->syntax_cache[i].syntax);
+  FREE (&pf->syntax_cache);
+  pf->syntax_cached = pf->syntax_max = 0;
+}
+
+static int syntax_cache_cmp (const void *a, const void *b)
+{
+  const struct syntax_cache_t *pa = (const struct syntax_cache_t *) a;
+  const struct syntax_cache_t *pb = (const struct syntax_cache_t *) b;
+
+  if (pa->offset < pb->offset)
+    return -1;
+  return (pa->offset > pb->offset);
+}
+
+static struct syntax_cache_t *
+syntax_cache_find (struct pager_file *pf, LOFF_T offset)
+{
+  struct syntax_cache_t key;
+
+  if (!pf->syntax_cached || pf->syntax_gen != ColorBodyGen ||
+      pf->syntax_partial != option (OPTHEADERCOLORPARTIAL))
+    return NULL;
+
+  key.offset = offset;
+  return bsearch (&key, pf->syntax_cache, pf->syntax_cached,
+		  sizeof (struct syntax_cache_t), syntax_cache_cmp);
+}
+
+/* Remember the pattern matches of the lines laid out so far, before
+ * lineInfo is thrown away for a reflow.  Only lines whose type is still
+ * one the patterns were run for are taken: retyping a line as a
+ * signature or a colored header clears or replaces its matches.
+ */
+static void syntax_cache_save (struct pager_file *pf, struct line_t *lineInfo,
+			       int last)
+{
+  struct syntax_cache_t *c;
+  int i, added = 0;
+
+  if (pf->syntax_gen != ColorBodyGen ||
+      pf->syntax_partial != option (OPTHEADERCOLORPARTIAL))
+  {
+    syntax_cache_free (pf);
+    pf->syntax_gen = ColorBodyGen;
+    pf->syntax_partial = option (OPTHEADERCOLORPARTIAL);
+  }
+
+  for (i = 0; i < last; i++)
+  {
+    if (lineInfo[i].continuation ||
+	!(lineInfo[i].type == MT_COLOR_NORMAL ||
+	  lineInfo[i].type == MT_COLOR_QUOTED ||
+	  (lineInfo[i].type == MT_COLOR_HDEFAULT && option (OPTHEADERCOLORPARTIAL))))
+      continue;
+    if (syntax_cache_find (pf, lineInfo[i].offset))
+      continue;
+
+    if (pf->syntax_cached + added == pf->syntax_max)
+      safe_realloc (&pf->syntax_cache, sizeof (struct syntax_cache_t) *
+		    (pf->syntax_max += MAX (LINES, pf->syntax_max / 2)));
+    c = &pf->syntax_cache[pf->syntax_cached + added++];
+    c->offset = lineInfo[i].offset;
+    c->hdr = (lineInfo[i].type == MT_COLOR_HDEFAULT);
+    c->chunks = lineInfo[i].chunks;
+    c->syntax = NULL;
+    if (c->chunks)
+    {
+      c->syntax = safe_malloc (sizeof (struct syntax_t) * c->chunks);
+      memcpy (c->syntax, lineInfo[i].syntax, sizeof (struct syntax_t) * c->chunks);
+    }
+  }
+
+  if (added)
+  {
+    pf->syntax_cached += added;
+    qsort (pf->syntax_cache, pf->syntax_cached, sizeof (struct syntax_cache_t),
+	   syntax_cache_cmp);
+  }
+}
+
 static void
-resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
-               struct q_class_t **QuoteList, int *q_level, int *force_redraw,
-               int q_classify)
+resolve_types (struct pager_file *pf, char *buf, char *raw,
+               struct line_t *lineInfo, int n, int last,
+               struct q_class_t **QuoteList, struct q_trie_t **QuoteTrie,
+               int *q_level, int *force_redraw, int q_classify)
 {
   COLOR_LINE *color_line, *color_list;
+  struct syntax_cache_t *cached;
   regmatch_t pmatch[1];
-  int found, offset, null_rx, i;
+  int found, offset, null_rx, i, ascii;
 
   if (n == 0 || ISHEADER (lineInfo[n-1].type) ||
       (check_protected_header_marker (raw) == 0))
@@ -793,9 +1055,11 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
        */
       if (!option (OPTHEADERCOLORPARTIAL))
       {
+        ascii = is_ascii (buf);
         for (color_line = ColorHdrList; color_line; color_line = color_line->next)
         {
-          if (REGEXEC (color_line->rx, buf) == 0)
+          if (!color_line_excluded (color_line, buf, ascii) &&
+              REGEXEC (color_line->rx, buf) == 0)
           {
             lineInfo[n].type = MT_COLOR_HEADER;
             lineInfo[n].syntax[0].color = color_line->pair;
@@ -851,7 +1115,8 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
   else if (mutt_is_quote_line (buf, pmatch))
   {
     if (q_classify && lineInfo[n].quote == NULL)
-      lineInfo[n].quote = classify_quote (QuoteList, buf + pmatch[0].rm_so,
+      lineInfo[n].quote = classify_quote (QuoteList, QuoteTrie,
+                                          buf + pmatch[0].rm_so,
                                           pmatch[0].rm_eo - pmatch[0].rm_so,
                                           force_redraw, q_level);
     lineInfo[n].type = MT_COLOR_QUOTED;
@@ -866,6 +1131,21 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
   {
     size_t nl;
 
+    /* laid out before a reflow: the matches are still the same */
+    if ((cached = syntax_cache_find (pf, lineInfo[n].offset)) != NULL &&
+        cached->hdr == (lineInfo[n].type == MT_COLOR_HDEFAULT))
+    {
+      lineInfo[n].chunks = cached->chunks;
+      if (cached->chunks)
+      {
+        safe_realloc (&(lineInfo[n].syntax),
+                      cached->chunks * sizeof (struct syntax_t));
+        memcpy (lineInfo[n].syntax, cached->syntax,
+                cached->chunks * sizeof (struct syntax_t));
+      }
+      return;
+    }
+
     /* don't consider line endings part of the buffer
      * for regex matching */
     if ((nl = mutt_strlen (buf)) > 0 && buf[nl-1] == '\n')
@@ -882,8 +1162,10 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
     while (color_line)
     {
       color_line->stop_matching = 0;
+      color_line->match_valid = 0;
       color_line = color_line->next;
     }
+    ascii = is_ascii (buf);
     do
     {
       if (!buf[offset])
@@ -895,8 +1177,7 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
       while (color_line)
       {
 	if (!color_line->stop_matching &&
-            regexec (&color_line->rx, buf + offset, 1, pmatch,
-		     (offset ? REG_NOTBOL : 0)) == 0)
+            color_line_regexec (color_line, buf, offset, ascii, pmatch) == 0)
 	{
 	  if (pmatch[0].rm_eo != pmatch[0].rm_so)
 	  {
@@ -1057,8 +1338,42 @@ static int grok_ansi(unsigned char *buf, int pos, ansi_attr *a)
   return pos;
 }
 
+#ifdef HAVE_MMAP
+/* Copy the line starting at offset out of the mapped file.  Returns
+ * its length including the newline, 0 at end of file, or -1 if the
+ * line contains a NUL byte; the caller then falls back to stdio so
+ * that such lines are split exactly as mutt_read_line() does it.
+ */
 static int
-fill_buffer (FILE *f, LOFF_T *last_pos, LOFF_T offset, unsigned char **buf,
+map_line (struct pager_file *pf, LOFF_T offset, unsigned char **buf,
+	  size_t *blen)
+{
+  unsigned char *p, *nl;
+  size_t len;
+
+  if (offset >= pf->size)
+    return 0;
+
+  p = pf->map + offset;
+  len = pf->size - offset;
+  if ((nl = memchr (p, '\n', len)) != NULL)
+    len = nl - p + 1;
+  if (len >= INT_MAX || memchr (p, 0, len) != NULL)
+    return -1;
+
+  if (!*buf || *blen <= len)
+  {
+    *blen = len + STRING;
+    safe_realloc (buf, *blen);
+  }
+  memcpy (*buf, p, len);
+  (*buf)[len] = 0;
+  return (int) len;
+}
+#endif
+
+static int
+fill_buffer (struct pager_file *pf, LOFF_T offset, unsigned char **buf,
 	     unsigned char **fmt, size_t *blen, int *buf_ready)
 {
   unsigned char *p, *q;
@@ -1067,15 +1382,32 @@ fill_buffer (FILE *f, LOFF_T *last_pos, LOFF_T offset, unsigned char **buf,
 
   if (*buf_ready == 0)
   {
-    if (offset != *last_pos)
-      fseeko (f, offset, 0);
-    if ((*buf = (unsigned char *) mutt_read_line ((char *) *buf, blen, f, &l, MUTT_EOL)) == NULL)
+#ifdef HAVE_MMAP
+    if (pf->map && (l = map_line (pf, offset, buf, blen)) >= 0)
     {
-      fmt[0] = 0;
-      return (-1);
+      if (l == 0)
+      {
+	FREE (buf);
+	fmt[0] = 0;
+	return (-1);
+      }
+      pf->last_pos = offset + l;
+      b_read = l;
+    }
+    else
+#endif
+    {
+      /* the stream position is only tracked for stdio reads */
+      if (pf->map || offset != pf->last_pos)
+	fseeko (pf->fp, offset, 0);
+      if ((*buf = (unsigned char *) mutt_read_line ((char *) *buf, blen, pf->fp, &l, MUTT_EOL)) == NULL)
+      {
+	fmt[0] = 0;
+	return (-1);
+      }
+      pf->last_pos = ftello (pf->fp);
+      b_read = (int) (pf->last_pos - offset);
     }
-    *last_pos = ftello (f);
-    b_read = (int) (*last_pos - offset);
     *buf_ready = 1;
 
     safe_realloc (fmt, *blen);
@@ -1314,9 +1646,10 @@ static int format_line (struct line_t **lineInfo, int n, unsigned char *buf,
  */
 
 static int
-display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
+display_line (struct pager_file *pf, struct line_t **lineInfo, int n,
 	      int *last, int *max, int flags, struct q_class_t **QuoteList,
-	      int *q_level, int *force_redraw, regex_t *SearchRE,
+	      struct q_trie_t **QuoteTrie, int *q_level, int *force_redraw,
+	      regex_t *SearchRE,
               mutt_window_t *pager_window)
 {
   unsigned char *buf = NULL, *fmt = NULL;
@@ -1340,7 +1673,9 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
 
   if (*last == *max)
   {
-    safe_realloc (lineInfo, sizeof (struct line_t) * (*max += LINES));
+    /* grow geometrically, so that laying out a huge message doesn't
+     * copy the whole line table again every screenful */
+    safe_realloc (lineInfo, sizeof (struct line_t) * (*max += MAX (LINES, *max / 2)));
     for (ch = *last; ch < *max ; ch++)
     {
       memset (&((*lineInfo)[ch]), 0, sizeof (struct line_t));
@@ -1357,15 +1692,16 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
     if ((*lineInfo)[n].type == -1)
     {
       /* determine the line class */
-      if (fill_buffer (f, last_pos, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
+      if (fill_buffer (pf, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
       {
 	if (change_last)
 	  (*last)--;
 	goto out;
       }
 
-      resolve_types ((char *) fmt, (char *) buf, *lineInfo, n, *last,
-                     QuoteList, q_level, force_redraw, flags & MUTT_SHOWCOLOR);
+      resolve_types (pf, (char *) fmt, (char *) buf, *lineInfo, n, *last,
+                     QuoteList, QuoteTrie, q_level, force_redraw,
+                     flags & MUTT_SHOWCOLOR);
 
       /* avoid race condition for continuation lines when scrolling up */
       for (m = n + 1; m < *last && (*lineInfo)[m].offset && (*lineInfo)[m].continuation; m++)
@@ -1386,7 +1722,7 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
   if ((flags & MUTT_SHOWCOLOR) && !(*lineInfo)[n].continuation &&
       (*lineInfo)[n].type == MT_COLOR_QUOTED && (*lineInfo)[n].quote == NULL)
   {
-    if (fill_buffer (f, last_pos, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
+    if (fill_buffer (pf, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
     {
       if (change_last)
 	(*last)--;
@@ -1394,7 +1730,7 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
     }
     regexec ((regex_t *) QuoteRegexp.rx, (char *) fmt, 1, pmatch, 0);
     (*lineInfo)[n].quote =
-      classify_quote (QuoteList,
+      classify_quote (QuoteList, QuoteTrie,
                       (char *) fmt + pmatch[0].rm_so,
                       pmatch[0].rm_eo - pmatch[0].rm_so,
                       force_redraw, q_level);
@@ -1402,7 +1738,7 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
 
   if ((flags & MUTT_SEARCH) && !(*lineInfo)[n].continuation && (*lineInfo)[n].search_cnt == -1)
   {
-    if (fill_buffer (f, last_pos, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
+    if (fill_buffer (pf, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
     {
       if (change_last)
 	(*last)--;
@@ -1445,7 +1781,7 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
     goto out; /* fake display */
   }
 
-  if ((b_read = fill_buffer (f, last_pos, (*lineInfo)[n].offset, &buf, &fmt,
+  if ((b_read = fill_buffer (pf, (*lineInfo)[n].offset, &buf, &fmt,
 			     &buflen, &buf_ready)) < 0)
   {
     if (change_last)
@@ -1607,7 +1943,7 @@ typedef struct
   int hideQuoted;
   int q_level;
   struct q_class_t *QuoteList;
-  LOFF_T last_pos;
+  struct q_trie_t *QuoteTrie;
   LOFF_T last_offset;
   mutt_window_t *index_status_window;
   mutt_window_t *index_window;
@@ -1622,7 +1958,7 @@ typedef struct
   const char *helpstr;
   char *searchbuf;
   struct line_t *lineInfo;
-  FILE *fp;
+  struct pager_file file;
   struct stat sb;
 } pager_redraw_data_t;
 
@@ -1644,6 +1980,7 @@ static void pager_menu_redraw (MUTTMENU *pager_menu)
     /* clear() doesn't optimize screen redraws */
     move (0, 0);
     clrtobot ();
+    ScreenClearGen++;
 
     if (IsHeader (rd->extra) && Context->vcount + 1 < PagerIndexLines)
       rd->indexlen = Context->vcount + 1;
@@ -1756,6 +2093,8 @@ static void pager_menu_redraw (MUTTMENU *pager_menu)
   {
     if (!(rd->flags & MUTT_PAGER_RETWINCH))
     {
+      syntax_cache_save (&rd->file, rd->lineInfo, rd->lastLine);
+
       rd->lines = -1;
       for (i = 0; i <= rd->topline; i++)
         if (!rd->lineInfo[i].continuation)
@@ -1780,9 +2119,9 @@ static void pager_menu_redraw (MUTTMENU *pager_menu)
     }
     i = -1;
     j = -1;
-    while (display_line (rd->fp, &rd->last_pos, &rd->lineInfo, ++i, &rd->lastLine, &rd->maxLine,
+    while (display_line (&rd->file, &rd->lineInfo, ++i, &rd->lastLine, &rd->maxLine,
                          rd->has_types | rd->SearchFlag | (rd->flags & MUTT_PAGER_NOWRAP),
-                         &rd->QuoteList, &rd->q_level, &rd->force_redraw,
+                         &rd->QuoteList, &rd->QuoteTrie, &rd->q_level, &rd->force_redraw,
                          &rd->SearchRE, rd->pager_window) == 0)
       if (!rd->lineInfo[i].continuation && ++j == rd->lines)
       {
@@ -1811,10 +2150,10 @@ static void pager_menu_redraw (MUTTMENU *pager_menu)
       while (rd->lines < rd->pager_window->rows &&
              rd->lineInfo[rd->curline].offset <= rd->sb.st_size - 1)
       {
-        if (display_line (rd->fp, &rd->last_pos, &rd->lineInfo, rd->curline, &rd->lastLine,
+        if (display_line (&rd->file, &rd->lineInfo, rd->curline, &rd->lastLine,
                           &rd->maxLine,
                           (rd->flags & MUTT_DISPLAYFLAGS) | rd->hideQuoted | rd->SearchFlag | (rd->flags & MUTT_PAGER_NOWRAP),
-                          &rd->QuoteList, &rd->q_level, &rd->force_redraw, &rd->SearchRE,
+                          &rd->QuoteList, &rd->QuoteTrie, &rd->q_level, &rd->force_redraw, &rd->SearchRE,
                           rd->pager_window) > 0)
           rd->lines++;
         rd->curline++;
@@ -1848,7 +2187,7 @@ static void pager_menu_redraw (MUTTMENU *pager_menu)
     hfi.ctx = Context;
     hfi.pager_progress = pager_progress_str;
 
-    if (rd->last_pos < rd->sb.st_size - 1)
+    if (rd->file.last_pos < rd->sb.st_size - 1)
       snprintf(pager_progress_str, sizeof(pager_progress_str), OFF_T_FMT "%%", (100 * rd->last_offset / rd->sb.st_size));
     else
       strfcpy(pager_progress_str, (rd->topline == 0) ? "all" : "end", sizeof(pager_progress_str));
@@ -1914,6 +2253,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
   int i, ch = 0, rc = -1;
   int err, first = 1;
   int r = -1, wrapped = 0, searchctx = 0;
+  int prerender;
 
   MUTTMENU *pager_menu = NULL;
   int old_PagerIndexLines;		/* some people want to resize it
@@ -1932,8 +2272,9 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
   rd.indicator = rd.indexlen / 3;
   rd.searchbuf = searchbuf;
   rd.has_types = (IsHeader(extra) || (flags & MUTT_SHOWCOLOR)) ? MUTT_TYPES : 0; /* main message or rfc822 attachment */
+  prerender = IsHeader (extra) && RenderCachedir && RenderPrefetch > 0;
 
-  if ((rd.fp = fopen (fname, "r")) == NULL)
+  if ((rd.file.fp = fopen (fname, "r")) == NULL)
   {
     mutt_perror (fname);
     return (-1);
@@ -1942,9 +2283,22 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
   if (stat (fname, &rd.sb) != 0)
   {
     mutt_perror (fname);
-    safe_fclose (&rd.fp);
+    safe_fclose (&rd.file.fp);
     return (-1);
   }
+#ifdef HAVE_MMAP
+  if (rd.sb.st_size > 0 && (off_t) (size_t) rd.sb.st_size == rd.sb.st_size)
+  {
+    void *map = mmap (NULL, (size_t) rd.sb.st_size, PROT_READ, MAP_PRIVATE,
+		      fileno (rd.file.fp), 0);
+
+    if (map != MAP_FAILED)
+    {
+      rd.file.map = map;
+      rd.file.size = rd.sb.st_size;
+    }
+  }
+#endif
   unlink (fname);
 
   /* Initialize variables */
@@ -2023,6 +2377,20 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
     else
       OldHdr = NULL;
 
+    /* use the first pause to get the next message ready */
+    if (prerender && mutt_idle (RenderPrefetch))
+    {
+      prerender = 0;
+      if (extra->hdr->virtual >= 0)
+        for (i = extra->hdr->virtual + 1; i < Context->vcount; i++)
+          if (!Context->hdrs[Context->v2r[i]]->deleted)
+          {
+            mutt_prerender_message (Context->hdrs[Context->v2r[i]]);
+            break;
+          }
+      continue;
+    }
+
     ch = km_dokey (MENU_PAGER);
     if (ch >= 0)
       mutt_clear_error ();
@@ -2302,9 +2670,9 @@ search_next:
 	  rd.SearchCompiled = 1;
 	  /* update the search pointers */
 	  i = 0;
-	  while (display_line (rd.fp, &rd.last_pos, &rd.lineInfo, i, &rd.lastLine,
+	  while (display_line (&rd.file, &rd.lineInfo, i, &rd.lastLine,
                                &rd.maxLine, MUTT_SEARCH | (flags & MUTT_PAGER_NSKIP) | (flags & MUTT_PAGER_NOWRAP),
-                               &rd.QuoteList, &rd.q_level,
+                               &rd.QuoteList, &rd.QuoteTrie, &rd.q_level,
                                &rd.force_redraw, &rd.SearchRE, rd.pager_window) == 0)
 	    i++;
 
@@ -2409,9 +2777,9 @@ search_next:
 	  int new_topline = rd.topline;
 
 	  while ((new_topline < rd.lastLine ||
-		  (0 == (dretval = display_line (rd.fp, &rd.last_pos, &rd.lineInfo,
+		  (0 == (dretval = display_line (&rd.file, &rd.lineInfo,
 			 new_topline, &rd.lastLine, &rd.maxLine, MUTT_TYPES | (flags & MUTT_PAGER_NOWRAP),
-                         &rd.QuoteList, &rd.q_level, &rd.force_redraw, &rd.SearchRE, rd.pager_window))))
+                         &rd.QuoteList, &rd.QuoteTrie, &rd.q_level, &rd.force_redraw, &rd.SearchRE, rd.pager_window))))
 		 && rd.lineInfo[new_topline].type != MT_COLOR_QUOTED)
 	    new_topline++;
 
@@ -2422,9 +2790,9 @@ search_next:
 	  }
 
 	  while ((new_topline < rd.lastLine ||
-		  (0 == (dretval = display_line (rd.fp, &rd.last_pos, &rd.lineInfo,
+		  (0 == (dretval = display_line (&rd.file, &rd.lineInfo,
 			 new_topline, &rd.lastLine, &rd.maxLine, MUTT_TYPES | (flags & MUTT_PAGER_NOWRAP),
-                         &rd.QuoteList, &rd.q_level, &rd.force_redraw, &rd.SearchRE, rd.pager_window))))
+                         &rd.QuoteList, &rd.QuoteTrie, &rd.q_level, &rd.force_redraw, &rd.SearchRE, rd.pager_window))))
 		 && rd.lineInfo[new_topline].type == MT_COLOR_QUOTED)
 	    new_topline++;
 
@@ -2442,9 +2810,9 @@ search_next:
 	{
 	  i = rd.curline;
 	  /* make sure the types are defined to the end of file */
-	  while (display_line (rd.fp, &rd.last_pos, &rd.lineInfo, i, &rd.lastLine,
+	  while (display_line (&rd.file, &rd.lineInfo, i, &rd.lastLine,
                                &rd.maxLine, rd.has_types | (flags & MUTT_PAGER_NOWRAP),
-                               &rd.QuoteList, &rd.q_level, &rd.force_redraw,
+                               &rd.QuoteList, &rd.QuoteTrie, &rd.q_level, &rd.force_redraw,
                                &rd.SearchRE, rd.pager_window) == 0)
 	    i++;
 	  rd.topline = upNLines (rd.pager_window->rows, rd.lineInfo, rd.lastLine, rd.hideQuoted);
@@ -2919,7 +3287,12 @@ search_next:
     }
   }
 
-  safe_fclose (&rd.fp);
+#ifdef HAVE_MMAP
+  if (rd.file.map)
+    munmap (rd.file.map, (size_t) rd.file.size);
+#endif
+  safe_fclose (&rd.file.fp);
+  syntax_cache_free (&rd.file);
   if (IsHeader (extra))
   {
     Context->msgnotreadyet = -1;
@@ -2937,6 +3310,7 @@ search_next:
   }
 
   cleanup_quote (&rd.QuoteList);
+  cleanup_quote_trie (&rd.QuoteTrie);
 
   for (i = 0; i < rd.maxLine ; i++)
   {
@@ -107,6 +107,9 @@ static pattern_t *SearchPattern = NULL; /* current search pattern */
 static char LastSearch[STRING] = { 0 };	/* last pattern searched for */
 static char LastSearchExpn[LONG_STRING] = { 0 }; /* expanded version of
 						    LastSearch */
+static int LastSearchPrefilter = 0;	/* h->matched holds a server prefilter */
+
+#define LIMIT_CACHE_SIZE 8		/* limit results remembered per folder */
 
 #define MUTT_MAXRANGE -1
 
@@ -842,6 +845,9 @@ static int eat_date (pattern_t *pat, int flags, BUFFER *s, BUFFER *err)
     pat->dynamic = 1;
     pat->p.str = safe_strdup (buffer.data);
   }
+  /* offsets and windows without a starting date count from today */
+  if (!isdigit ((unsigned char) *buffer.data))
+    pat->relative = 1;
 
   rc = eval_date_minmax (pat, buffer.data, err);
 
@@ -1605,13 +1611,201 @@ void mutt_check_simple (BUFFER *s, const char *simple)
   }
 }
 
+/* returns 1 if the result of pat only depends on the message's headers
+ * and content (and the configuration), but not on its flags, score,
+ * size, crypto state, position or thread. */
+int mutt_pattern_is_stable (const pattern_t *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    switch (pat->op)
+    {
+      case MUTT_AND:
+      case MUTT_OR:
+        if (!mutt_pattern_is_stable (pat->child))
+          return 0;
+        break;
+      case MUTT_DATE:
+      case MUTT_DATE_RECEIVED:
+        if (pat->dynamic)
+          return 0;
+        break;
+      case MUTT_ALL:
+      case MUTT_NONE:
+      case MUTT_SUBJECT:
+      case MUTT_FROM:
+      case MUTT_TO:
+      case MUTT_CC:
+      case MUTT_SENDER:
+      case MUTT_RECIPIENT:
+      case MUTT_ADDRESS:
+      case MUTT_ID:
+      case MUTT_REFERENCE:
+      case MUTT_BODY:
+      case MUTT_HEADER:
+      case MUTT_WHOLE_MSG:
+      case MUTT_HORMEL:
+      case MUTT_LIST:
+      case MUTT_SUBSCRIBED_LIST:
+      case MUTT_PERSONAL_RECIP:
+      case MUTT_PERSONAL_FROM:
+      case MUTT_XLABEL:
+      case MUTT_MIMETYPE:
+        break;
+      default:
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* returns 1 if the result of pat only changes when message flags or
+ * headers do (and thus ctx->gen is bumped).  Patterns depending on the
+ * sort order, threading, the current time or configuration are never
+ * cached. */
+static int pattern_cacheable (const pattern_t *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    if (pat->groupmatch || pat->isalias || pat->dynamic || pat->relative)
+      return 0;
+
+    switch (pat->op)
+    {
+      case MUTT_MESSAGE:
+      case MUTT_THREAD:
+      case MUTT_PARENT:
+      case MUTT_CHILDREN:
+      case MUTT_COLLAPSED:
+      case MUTT_DUPLICATED:
+      case MUTT_UNREFERENCED:
+      case MUTT_SCORE:
+      case MUTT_LIST:
+      case MUTT_SUBSCRIBED_LIST:
+      case MUTT_PERSONAL_RECIP:
+      case MUTT_PERSONAL_FROM:
+      case MUTT_MIMEATTACH:
+      /* h->security changes when a message is displayed */
+      case MUTT_CRYPT_SIGN:
+      case MUTT_CRYPT_VERIFIED:
+      case MUTT_CRYPT_ENCRYPT:
+      case MUTT_PGP_KEY:
+        return 0;
+    }
+
+    if (pat->child && !pattern_cacheable (pat->child))
+      return 0;
+  }
+
+  return 1;
+}
+
+/* returns 1 if the pattern string next is prev with further terms
+ * appended, ie prev AND the new terms.  A '|' anywhere makes the top
+ * level an OR, which appending terms widens, so those aren't
+ * considered. */
+static int pattern_is_narrowing (const char *prev, const char *next)
+{
+  size_t len = mutt_strlen (prev);
+  char quote = 0;
+
+  if (!len || mutt_strncmp (prev, next, len) || !ISSPACE (next[len]))
+    return 0;
+
+  for (; *next; next++)
+  {
+    if (*next == '\\' && next[1])
+      next++;
+    else if (quote)
+    {
+      if (*next == quote)
+        quote = 0;
+    }
+    else if (*next == '"' || *next == '\'')
+      quote = *next;
+    else if (*next == '|')
+      return 0;
+  }
+
+  return 1;
+}
+
+static void limit_cache_free_entry (LIMIT_CACHE **entry)
+{
+  FREE (&(*entry)->pattern);
+  FREE (&(*entry)->matched);
+  FREE (entry);		/* __FREE_CHECKED__ */
+}
+
+void mutt_limit_cache_free (LIMIT_CACHE **cache)
+{
+  LIMIT_CACHE *next;
+
+  while (*cache)
+  {
+    next = (*cache)->next;
+    limit_cache_free_entry (cache);
+    *cache = next;
+  }
+}
+
+/* finds the cached result for pattern and moves it to the front.
+ * Outdated results are dropped on the way. */
+static LIMIT_CACHE *limit_cache_find (CONTEXT *ctx, const char *pattern)
+{
+  LIMIT_CACHE **p, *entry;
+
+  for (p = &ctx->limit_cache; *p; )
+  {
+    entry = *p;
+    if (entry->gen != ctx->gen || entry->msgcount > ctx->msgcount)
+    {
+      *p = entry->next;
+      limit_cache_free_entry (&entry);
+      continue;
+    }
+    if (!mutt_strcmp (entry->pattern, pattern))
+    {
+      *p = entry->next;
+      entry->next = ctx->limit_cache;
+      ctx->limit_cache = entry;
+      return entry;
+    }
+    p = &entry->next;
+  }
+
+  return NULL;
+}
+
+static LIMIT_CACHE *limit_cache_add (CONTEXT *ctx, const char *pattern)
+{
+  LIMIT_CACHE *entry, **p;
+  int i;
+
+  entry = safe_calloc (1, sizeof (LIMIT_CACHE));
+  entry->pattern = safe_strdup (pattern);
+  entry->gen = ctx->gen;
+  entry->next = ctx->limit_cache;
+  ctx->limit_cache = entry;
+
+  /* forget the least recently used result */
+  for (i = 1, p = &entry->next; *p && i < LIMIT_CACHE_SIZE; i++)
+    p = &(*p)->next;
+  mutt_limit_cache_free (p);
+
+  return entry;
+}
+
 int mutt_pattern_func (int op, char *prompt)
 {
   pattern_t *pat = NULL;
   BUFFER *buf = NULL;
   char *simple = NULL;
   BUFFER err;
-  int i, rv = -1, padding;
+  int i, rv = -1, padding, prefilter = 0;
+  int narrowing = 0, match;
+  LIMIT_CACHE *cached = NULL, *current = NULL;
   progress_t progress;
 
   buf = mutt_buffer_pool_get ();
@@ -1638,8 +1832,47 @@ int mutt_pattern_func (int op, char *prompt)
     goto bail;
   }
 
+  if (op == MUTT_LIMIT && pattern_cacheable (pat))
+  {
+    /* is the current limit still valid, and the new one a refinement? */
+    if (Context->limit_cache && Context->pattern &&
+        Context->limit_cache->gen == Context->gen)
+    {
+      BUFFER *prev = mutt_buffer_pool_get ();
+
+      mutt_buffer_strcpy (prev, Context->pattern);
+      mutt_check_simple (prev, NONULL (SimpleSearch));
+      narrowing = !mutt_strcmp (Context->limit_cache->pattern, mutt_b2s (prev)) &&
+        pattern_is_narrowing (mutt_b2s (prev), mutt_b2s (buf));
+      mutt_buffer_pool_release (&prev);
+    }
+
+    cached = limit_cache_find (Context, mutt_b2s (buf));
+    if (cached)
+    {
+      dprint (2, (debugfile, "mutt_pattern_func: reusing limit %s (%d/%d messages)\n",
+                  cached->pattern, cached->msgcount, Context->msgcount));
+      current = cached;
+    }
+    else
+      current = limit_cache_add (Context, mutt_b2s (buf));
+
+    if (current->msgcount < Context->msgcount)
+    {
+      unsigned char *matched = mutt_bit_alloc (Context->msgcount);
+
+      if (current->matched)
+        memcpy (matched, current->matched, (current->msgcount + 7) / 8);
+      FREE (&current->matched);
+      current->matched = matched;
+    }
+  }
+
 #ifdef USE_IMAP
-  if (Context->magic == MUTT_IMAP && imap_search (Context, pat) < 0)
+  /* a complete cached result doesn't need the server */
+  if (Context->magic == MUTT_IMAP &&
+      (!cached || cached->msgcount < Context->msgcount) &&
+      (prefilter = imap_search (Context, pat)) < 0)
     goto bail;
 #endif
 
@@ -1656,13 +1889,26 @@ int mutt_pattern_func (int op, char *prompt)
 
     for (i = 0; i < Context->msgcount; i++)
     {
+      HEADER *h = Context->hdrs[i];
+
       mutt_progress_update (&progress, i, -1);
+
+      if (cached && h->index < cached->msgcount)
+        match = mutt_bit_isset (cached->matched, h->index);
+      else if (narrowing && !h->limited)
+        match = 0;
+      else
+        match = (!prefilter || h->matched) &&
+          mutt_pattern_exec (pat, MUTT_MATCH_FULL_ADDRESS, Context, h, NULL);
+      if (current && match)
+        mutt_bit_set (current->matched, h->index);
+
       /* new limit pattern implicitly uncollapses all threads */
-      Context->hdrs[i]->virtual = -1;
-      Context->hdrs[i]->limited = 0;
-      Context->hdrs[i]->collapsed = 0;
-      Context->hdrs[i]->num_hidden = 0;
-      if (mutt_pattern_exec (pat, MUTT_MATCH_FULL_ADDRESS, Context, Context->hdrs[i], NULL))
+      h->virtual = -1;
+      h->limited = 0;
+      h->collapsed = 0;
+      h->num_hidden = 0;
+      if (match)
       {
 	BODY *this_body = Context->hdrs[i]->content;
 
@@ -1680,7 +1926,8 @@ int mutt_pattern_func (int op, char *prompt)
     for (i = 0; i < Context->vcount; i++)
     {
       mutt_progress_update (&progress, i, -1);
-      if (mutt_pattern_exec (pat, MUTT_MATCH_FULL_ADDRESS, Context, Context->hdrs[Context->v2r[i]], NULL))
+      if ((!prefilter || Context->hdrs[Context->v2r[i]]->matched) &&
+          mutt_pattern_exec (pat, MUTT_MATCH_FULL_ADDRESS, Context, Context->hdrs[Context->v2r[i]], NULL))
       {
 	switch (op)
 	{
@@ -1704,6 +1951,9 @@ int mutt_pattern_func (int op, char *prompt)
 
   mutt_clear_error ();
 
+  if (current)
+    current->msgcount = Context->msgcount;
+
   if (op == MUTT_LIMIT)
   {
     const char *pbuf;
@@ -1801,9 +2051,14 @@ int mutt_search_command (int cur, int op)
   {
     for (i = 0; i < Context->msgcount; i++)
       Context->hdrs[i]->searched = 0;
+    LastSearchPrefilter = 0;
 #ifdef USE_IMAP
-    if (Context->magic == MUTT_IMAP && imap_search (Context, SearchPattern) < 0)
+    if (Context->magic == MUTT_IMAP &&
+        (LastSearchPrefilter = imap_search (Context, SearchPattern)) < 0)
+    {
+      LastSearchPrefilter = 0;
       return -1;
+    }
 #endif
     unset_option (OPTSEARCHINVALID);
   }
@@ -1853,6 +2108,9 @@ int mutt_search_command (int cur, int op)
 	return i;
       }
     }
+    else if (LastSearchPrefilter && !h->matched)
+      /* the server already ruled this message out */
+      h->searched = 1;
     else
     {
       /* remember that we've already searched this message */
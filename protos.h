@@ -324,6 +324,7 @@ int mutt_compose_attachment (BODY *a);
 int mutt_copy_body (FILE *, BODY **, BODY *);
 int mutt_decode_save_attachment (FILE *, BODY *, const char *, int, int);
 int mutt_display_message (HEADER *h);
+void mutt_prerender_message (HEADER *h);
 int mutt_dump_variables (void);
 int mutt_edit_attachment(BODY *);
 int mutt_edit_address (ADDRESS **, const char *, int);
@@ -390,6 +391,7 @@ int mutt_pipe_attachment (FILE *, BODY *, const char *, const char *);
 int mutt_print_attachment (FILE *, BODY *);
 int mutt_query_complete (char *, size_t);
 int mutt_query_variables (LIST *queries);
+void mutt_config_digest (unsigned char *);
 int mutt_save_attachment (FILE *, BODY *, const char *, int, HEADER *);
 int _mutt_save_message (HEADER *, CONTEXT *, int, int, int);
 int mutt_save_message (HEADER *, int, int, int);
@@ -416,6 +418,7 @@ int mutt_write_rfc822_header (FILE *, ENVELOPE *, BODY *, mutt_write_header_mode
 void mutt_write_references (LIST *, FILE *, int);
 int mutt_yesorno (const char *, int);
 void mutt_set_header_color(CONTEXT *, HEADER *);
+void mutt_reset_header_color (HEADER *);
 void mutt_sleep (short);
 int mutt_save_confirm (const char  *, struct stat *);
 
@@ -456,9 +459,11 @@ int mutt_wctoutf8 (char *s, unsigned int c, size_t buflen);
 #define new_pattern() safe_calloc(1, sizeof (pattern_t))
 
 int mutt_pattern_exec (struct pattern_t *pat, pattern_exec_flag flags, CONTEXT *ctx, HEADER *h, pattern_cache_t *);
+int mutt_pattern_is_stable (const struct pattern_t *pat);
 pattern_t *mutt_pattern_comp (/* const */ char *s, int flags, BUFFER *err);
 void mutt_check_simple (BUFFER *s, const char *simple);
 void mutt_pattern_free (pattern_t **pat);
+void mutt_limit_cache_free (LIMIT_CACHE **cache);
 
 /* ----------------------------------------------------------------------------
  * Prototypes for broken systems
@@ -40,6 +40,11 @@ typedef struct sidebar_entry
   char         box[STRING];     /* formatted mailbox name */
   BUFFY       *buffy;
   short        is_hidden;
+  /* the BUFFY's counts when the entries were last sorted and filtered */
+  int          msg_count;
+  int          msg_unread;
+  int          msg_flagged;
+  short        new;
 } SBENTRY;
 
 static int EntryCount = 0;
@@ -51,6 +56,30 @@ static int OpnIndex = -1;    /* Current (open) mailbox */
 static int HilIndex = -1;    /* Highlighted mailbox */
 static int BotIndex = -1;    /* Last mailbox visible in sidebar */
 
+/* Set when entries were added: they have to be sorted and filtered */
+static short EntriesDirty = 1;
+
+/* What update_entries_visibility() last looked at */
+static SBENTRY *VisOpnEntry = NULL;
+static char *VisContextPath = NULL;
+static unsigned long VisGen = 0;
+
+/* what was last drawn on each row, so that unchanged rows aren't sent again */
+struct sb_row
+{
+  char *text;		/* NULL if unknown or blank */
+  int attr;
+  short blank;
+};
+
+static struct sb_row *SbRows = NULL;
+static int SbRowsLen = 0;
+static int SbRowsCols = -1;	/* sidebar geometry the rows were drawn with */
+static int SbRowsWidth = -1;
+static int SbRowsOffset = -1;
+static unsigned long SbRowsGen = 0;
+static unsigned long SbRowsScreen = 0;
+
 static int select_next (void);
 
 
@@ -277,6 +306,24 @@ static int cb_qsort_sbe (const void *a, const void *b)
   return result;
 }
 
+/**
+ * entry_changed - Have the BUFFY's counts changed since the last sort
+ * @sbe: SBENTRY to check
+ *
+ * Returns:
+ *	1: Yes, the entry may need to move or be shown/hidden
+ *	0: No
+ */
+static int entry_changed (const SBENTRY *sbe)
+{
+  const BUFFY *b = sbe->buffy;
+
+  return (sbe->msg_count   != b->msg_count)  ||
+         (sbe->msg_unread  != b->msg_unread) ||
+         (sbe->msg_flagged != b->msg_flagged) ||
+         (sbe->new         != b->new);
+}
+
 /**
  * update_entries_visibility - Should a sidebar_entry be displayed in the sidebar
  *
@@ -287,21 +334,36 @@ static int cb_qsort_sbe (const void *a, const void *b)
  *	has unread messages
  *	has flagged messages
  *	is whitelisted
+ *
+ * Only entries whose counts changed are looked at again, unless the open
+ * mailbox or the config changed since the last call.
  */
 static void update_entries_visibility (void)
 {
   short new_only = option (OPTSIDEBARNEWMAILONLY);
+  short force;
   SBENTRY *sbe;
   int i;
 
+  /* The other criteria only change with the open mailbox or the config */
+  force = EntriesDirty || (VisGen != IndexRowGen) ||
+          (VisOpnEntry != ((OpnIndex >= 0) ? Entries[OpnIndex] : NULL)) ||
+          mutt_strcmp (VisContextPath, Context ? Context->realpath : NULL);
+
   for (i = 0; i < EntryCount; i++)
   {
     sbe = Entries[i];
 
-    sbe->is_hidden = 0;
-
     if (!new_only)
+    {
+      sbe->is_hidden = 0;
       continue;
+    }
+
+    if (!force && !entry_changed (sbe))
+      continue;
+
+    sbe->is_hidden = 0;
 
     if ((i == OpnIndex) || (sbe->buffy->msg_unread  > 0) || sbe->buffy->new ||
         (sbe->buffy->msg_flagged > 0))
@@ -317,6 +379,10 @@ static void update_entries_visibility (void)
 
     sbe->is_hidden = 1;
   }
+
+  VisGen = IndexRowGen;
+  VisOpnEntry = (OpnIndex >= 0) ? Entries[OpnIndex] : NULL;
+  mutt_str_replace (&VisContextPath, Context ? Context->realpath : NULL);
 }
 
 /**
@@ -348,6 +414,27 @@ static void unsort_entries (void)
   }
 }
 
+/**
+ * resort_entries - Move changed entries back into place
+ *
+ * The Entries array is still sorted, apart from the entries whose counts
+ * have changed.  A (stable) insertion sort puts those back where they
+ * belong without comparing every pair again.
+ */
+static void resort_entries (void)
+{
+  SBENTRY *tmp;
+  int i, j;
+
+  for (i = 1; i < EntryCount; i++)
+  {
+    tmp = Entries[i];
+    for (j = i; (j > 0) && (cb_qsort_sbe (&Entries[j - 1], &tmp) > 0); j--)
+      Entries[j] = Entries[j - 1];
+    Entries[j] = tmp;
+  }
+}
+
 /**
  * sort_entries - Sort Entries array.
  *
@@ -355,18 +442,39 @@ static void unsort_entries (void)
  * option "sidebar_sort_method". This calls qsort to do the work which calls our
  * callback function "cb_qsort_sbe".
  *
+ * If neither the sort method nor the set of entries changed, only a change
+ * to an entry's sort key makes it resort, and then incrementally.
+ *
  * Once sorted, the prev/next links will be reconstructed.
  */
 static void sort_entries (void)
 {
   short ssm = (SidebarSortMethod & SORT_MASK);
+  int i;
 
   /* These are the only sort methods we understand */
   if ((ssm == SORT_COUNT)     ||
       (ssm == SORT_UNREAD)    ||
       (ssm == SORT_FLAGGED)   ||
       (ssm == SORT_PATH))
-    qsort (Entries, EntryCount, sizeof (*Entries), cb_qsort_sbe);
+  {
+    if (EntriesDirty || (SidebarSortMethod != PreviousSort))
+      qsort (Entries, EntryCount, sizeof (*Entries), cb_qsort_sbe);
+    else if (ssm != SORT_PATH)
+    {
+      for (i = 0; i < EntryCount; i++)
+      {
+        if ((ssm == SORT_COUNT) ?
+            (Entries[i]->msg_count != Entries[i]->buffy->msg_count) :
+            (ssm == SORT_UNREAD) ?
+            (Entries[i]->msg_unread != Entries[i]->buffy->msg_unread) :
+            (Entries[i]->msg_flagged != Entries[i]->buffy->msg_flagged))
+          break;
+      }
+      if (i < EntryCount)
+        resort_entries ();
+    }
+  }
   else if ((ssm == SORT_ORDER) &&
            (SidebarSortMethod != PreviousSort))
     unsort_entries ();
@@ -379,8 +487,9 @@ static void sort_entries (void)
  * Before painting the sidebar, we determine which are visible, sort
  * them and set up our page pointers.
  *
- * This is a lot of work to do each refresh, but there are many things that
- * can change outside of the sidebar that we don't hear about.
+ * There are many things that can change outside of the sidebar that we
+ * don't hear about, so this is done on each refresh.  To keep it cheap,
+ * entries are only resorted and refiltered when their counts changed.
  *
  * Returns:
  *	0: No, don't draw the sidebar
@@ -409,7 +518,13 @@ static int prepare_sidebar (int page_size)
       OpnIndex = i;
     if (hil_entry == Entries[i])
       HilIndex = i;
+
+    Entries[i]->msg_count   = Entries[i]->buffy->msg_count;
+    Entries[i]->msg_unread  = Entries[i]->buffy->msg_unread;
+    Entries[i]->msg_flagged = Entries[i]->buffy->msg_flagged;
+    Entries[i]->new         = Entries[i]->buffy->new;
   }
+  EntriesDirty = 0;
 
   if ((HilIndex < 0) || Entries[HilIndex]->is_hidden ||
       (SidebarSortMethod != PreviousSort))
@@ -474,7 +589,7 @@ static int prepare_sidebar (int page_size)
  *	0:  Error: 0 width character
  *	n:  Success: character occupies n screen columns
  */
-static int draw_divider (int num_rows, int num_cols)
+static int draw_divider (int num_rows, int num_cols, int redraw)
 {
   /* Calculate the width of the delimiter in screen cells */
   int delim_len = mutt_strwidth (SidebarDividerChar);
@@ -485,6 +600,9 @@ static int draw_divider (int num_rows, int num_cols)
   if (delim_len > num_cols)
     return 0;
 
+  if (!redraw)
+    return delim_len;
+
   SETCOLOR(MT_COLOR_DIVIDER);
 
   int i;
@@ -497,6 +615,40 @@ static int draw_divider (int num_rows, int num_cols)
   return delim_len;
 }
 
+/**
+ * sync_rows - Forget what was drawn if the screen may no longer show it
+ * @num_rows:   Number of rows in the Sidebar
+ * @num_cols:   Width of the Sidebar window
+ *
+ * Returns:
+ *      1: The rows still show what SbRows says
+ *      0: SbRows was reset; everything has to be drawn
+ */
+static int sync_rows (int num_rows, int num_cols)
+{
+  int i;
+
+  if ((SbRowsScreen == ScreenClearGen) && (SbRowsGen == IndexRowGen) &&
+      (SbRowsLen == num_rows) && (SbRowsCols == num_cols) &&
+      (SbRowsWidth == SidebarWidth) &&
+      (SbRowsOffset == MuttSidebarWindow->col_offset))
+    return 1;
+
+  for (i = 0; i < SbRowsLen; i++)
+    FREE (&SbRows[i].text);
+  safe_realloc (&SbRows, num_rows * sizeof (struct sb_row));
+  if (SbRows)
+    memset (SbRows, 0, num_rows * sizeof (struct sb_row));
+
+  SbRowsLen    = num_rows;
+  SbRowsCols   = num_cols;
+  SbRowsWidth  = SidebarWidth;
+  SbRowsOffset = MuttSidebarWindow->col_offset;
+  SbRowsGen    = IndexRowGen;
+  SbRowsScreen = ScreenClearGen;
+  return 0;
+}
+
 /**
  * fill_empty_space - Wipe the remaining Sidebar space
  * @first_row:  Window line to start (0-based)
@@ -504,20 +656,39 @@ static int draw_divider (int num_rows, int num_cols)
  * @width:      Width of the Sidebar (minus the divider)
  *
  * Write spaces over the area the sidebar isn't using.
+ *
+ * Returns:
+ *      The number of rows actually written
  */
-static void fill_empty_space (int first_row, int num_rows, int width)
+static int fill_empty_space (int first_row, int num_rows, int width)
 {
+  int redrawn = 0;
+
   /* Fill the remaining rows with blank space */
   SETCOLOR(MT_COLOR_NORMAL);
 
   int r;
   for (r = 0; r < num_rows; r++)
   {
+    struct sb_row *sbr = NULL;
+
+    if (first_row + r < SbRowsLen)
+    {
+      sbr = &SbRows[first_row + r];
+      if (sbr->blank)
+        continue;
+      FREE (&sbr->text);
+      sbr->blank = 1;
+    }
+
     mutt_window_move (MuttSidebarWindow, first_row + r, 0);	//RAR rhs
     int i;
     for (i = 0; i < width; i++)
       addch (' ');
+    redrawn++;
   }
+
+  return redrawn;
 }
 
 /**
@@ -634,6 +805,9 @@ static void draw_sidebar (int num_rows, int num_cols, int div_width)
 
   int w = MIN(num_cols, (SidebarWidth - div_width));
   int row = 0;
+  int color;
+  int redrawn = 0;
+  long bytes = 0;
   for (entryidx = TopIndex; (entryidx < EntryCount) && (row < num_rows); entryidx++)
   {
     entry = Entries[entryidx];
@@ -644,23 +818,22 @@ static void draw_sidebar (int num_rows, int num_cols, int div_width)
     if (entryidx == OpnIndex)
     {
       if ((ColorDefs[MT_COLOR_SB_INDICATOR] != 0))
-        SETCOLOR(MT_COLOR_SB_INDICATOR);
+        color = MT_COLOR_SB_INDICATOR;
       else
-        SETCOLOR(MT_COLOR_INDICATOR);
+        color = MT_COLOR_INDICATOR;
     }
     else if (entryidx == HilIndex)
-      SETCOLOR(MT_COLOR_HIGHLIGHT);
+      color = MT_COLOR_HIGHLIGHT;
     else if ((b->msg_unread > 0) || (b->new))
-      SETCOLOR(MT_COLOR_NEW);
+      color = MT_COLOR_NEW;
     else if (b->msg_flagged > 0)
-      SETCOLOR(MT_COLOR_FLAGGED);
+      color = MT_COLOR_FLAGGED;
     else if ((ColorDefs[MT_COLOR_SB_SPOOLFILE] != 0) &&
              (mutt_strcmp (mutt_b2s (b->pathbuf), Spoolfile) == 0))
-      SETCOLOR(MT_COLOR_SB_SPOOLFILE);
+      color = MT_COLOR_SB_SPOOLFILE;
     else
-      SETCOLOR(MT_COLOR_NORMAL);
+      color = MT_COLOR_NORMAL;
 
-    mutt_window_move (MuttSidebarWindow, row, 0);
     if (Context && Context->realpath &&
         !mutt_strcmp (b->realpath, Context->realpath))
     {
@@ -770,7 +943,27 @@ static void draw_sidebar (int num_rows, int num_cols, int div_width)
 
     char str[STRING];
     make_sidebar_entry (str, sizeof (str), w, sidebar_folder_name, entry);
+
+    if (row < SbRowsLen)
+    {
+      struct sb_row *sbr = &SbRows[row];
+
+      if (sbr->text && (sbr->attr == ColorDefs[color]) &&
+          !mutt_strcmp (sbr->text, str))
+      {
+        row++;
+        continue;
+      }
+      mutt_str_replace (&sbr->text, str);
+      sbr->attr = ColorDefs[color];
+      sbr->blank = 0;
+    }
+
+    SETCOLOR(color);
+    mutt_window_move (MuttSidebarWindow, row, 0);
     printw ("%s", str);
+    redrawn++;
+    bytes += mutt_strlen (str);
     row++;
   }
 
@@ -778,7 +971,10 @@ static void draw_sidebar (int num_rows, int num_cols, int div_width)
   mutt_buffer_pool_release (&last_folder_name);
   mutt_buffer_pool_release (&indent_folder_name);
 
-  fill_empty_space (row, num_rows - row, w);
+  redrawn += fill_empty_space (row, num_rows - row, w);
+
+  dprint (3, (debugfile, "draw_sidebar: %d of %d rows redrawn, %ld bytes\n",
+              redrawn, num_rows, bytes));
 }
 
 
@@ -796,7 +992,9 @@ void mutt_sb_draw (void)
   int num_rows  = MuttSidebarWindow->rows;
   int num_cols  = MuttSidebarWindow->cols;
 
-  int div_width = draw_divider (num_rows, num_cols);
+  int unchanged = sync_rows (num_rows, num_cols);
+
+  int div_width = draw_divider (num_rows, num_cols, !unchanged);
   if (div_width < 0)
     return;
 
@@ -1048,6 +1246,11 @@ void mutt_sb_set_buffystats (const CONTEXT *ctx)
   if (!ctx || !b)
     return;
 
+  /* Usually it's the open mailbox, which we already know */
+  if ((OpnIndex >= 0) &&
+      !mutt_strcmp (Entries[OpnIndex]->buffy->realpath, ctx->realpath))
+    b = Entries[OpnIndex]->buffy;
+
   for (; b; b = b->next)
   {
     if (!mutt_strcmp (b->realpath, ctx->realpath))
@@ -1143,6 +1346,7 @@ void mutt_sb_notify_mailbox (BUFFY *b, int created)
       OpnIndex = EntryCount;
 
     EntryCount++;
+    EntriesDirty = 1;
   }
   else
   {
@@ -1151,6 +1355,8 @@ void mutt_sb_notify_mailbox (BUFFY *b, int created)
         break;
     if (del_index == EntryCount)
       return;
+    if (VisOpnEntry == Entries[del_index])
+      VisOpnEntry = NULL;
     FREE (&Entries[del_index]);
     EntryCount--;
 
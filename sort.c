@@ -273,6 +273,285 @@ sort_t *mutt_get_sort_func (int method)
   /* not reached */
 }
 
+/* Sorting large folders with qsort() and the compare functions above is
+ * dominated by the comparisons themselves: each one chases pointers into
+ * two scattered HEADERs, and sorting by author or recipient looks up and
+ * copies both names every time.  For the common sort methods the keys are
+ * instead computed once per message.  Integer keys are ordered by a radix
+ * sort, case-folded strings by a merge sort.  Both are stable, so sorting
+ * by message index, $sort_aux and $sort in turn yields the same order as
+ * the compare functions. */
+
+/* maps a signed key to an unsigned one with the same order */
+#define SORT_NUM(x) ((unsigned long long) (long long) (x) ^ (1ULL << 63))
+
+/* returns 1 if the keys of method can be computed up front */
+static int sort_has_keys (int method)
+{
+  switch (method & SORT_MASK)
+  {
+    case SORT_RECEIVED:
+    case SORT_ORDER:
+    case SORT_DATE:
+    case SORT_SIZE:
+    case SORT_SCORE:
+    case SORT_SUBJECT:
+    case SORT_FROM:
+    case SORT_TO:
+      return 1;
+  }
+  return 0;
+}
+
+/* appends the case-folded s to arena, keeping at most max characters */
+static void sort_keys_fold (BUFFER *arena, SORT_KEY *key, const char *s,
+                            size_t max)
+{
+  size_t n;
+
+  key->stroff = mutt_buffer_len (arena);
+  for (n = 0; *s && n < max; n++, s++)
+    mutt_buffer_addch (arena, tolower ((unsigned char) *s));
+  mutt_buffer_addch (arena, '\0');
+}
+
+/* fills in the keys for method.  String keys are stored in arena. */
+static void sort_keys_fill (SORT_KEY *keys, int n, int method, BUFFER *arena)
+{
+  int i;
+  HEADER *h;
+
+  mutt_buffer_clear (arena);
+
+  for (i = 0; i < n; i++)
+  {
+    h = keys[i].h;
+    keys[i].str = NULL;
+    keys[i].stroff = (size_t) -1;
+    switch (method & SORT_MASK)
+    {
+      case SORT_RECEIVED:
+        keys[i].num = SORT_NUM (h->received);
+        break;
+      case SORT_ORDER:
+        keys[i].num = SORT_NUM (h->index);
+        break;
+      case SORT_DATE:
+        keys[i].num = SORT_NUM (h->date_sent);
+        break;
+      case SORT_SIZE:
+        keys[i].num = SORT_NUM (h->content->length);
+        break;
+      case SORT_SCORE:
+        /* highest score first */
+        keys[i].num = SORT_NUM (-(long long) h->score);
+        break;
+      case SORT_SUBJECT:
+        /* messages without a subject go first, by date */
+        keys[i].num = SORT_NUM (h->date_sent);
+        if (h->env->real_subj)
+          sort_keys_fold (arena, &keys[i], h->env->real_subj, (size_t) -1);
+        break;
+      /* compare_from and compare_to only look at the first SHORT_STRING - 1 */
+      case SORT_FROM:
+        sort_keys_fold (arena, &keys[i], mutt_get_name (h->env->from),
+                        SHORT_STRING - 1);
+        break;
+      case SORT_TO:
+        sort_keys_fold (arena, &keys[i], mutt_get_name (h->env->to),
+                        SHORT_STRING - 1);
+        break;
+    }
+  }
+
+  /* the arena is done growing */
+  for (i = 0; i < n; i++)
+    if (keys[i].stroff != (size_t) -1)
+      keys[i].str = arena->data + keys[i].stroff;
+}
+
+/* stable LSD radix sort on num.  Passes over bytes that are the same for
+ * every key (eg the high bytes of dates) are skipped. */
+static void sort_keys_radix (SORT_KEY *keys, SORT_KEY *tmp, int n, int reverse)
+{
+  size_t count[sizeof (unsigned long long)][256];
+  size_t pos[256];
+  unsigned long long num;
+  SORT_KEY *from = keys, *to = tmp, *swap;
+  int i, byte, b;
+
+  memset (count, 0, sizeof (count));
+  for (i = 0; i < n; i++)
+  {
+    if (reverse)
+      keys[i].num = ~keys[i].num;
+    for (num = keys[i].num, byte = 0; byte < sizeof (num); byte++, num >>= 8)
+      count[byte][num & 0xff]++;
+  }
+
+  for (byte = 0; byte < sizeof (num); byte++)
+  {
+    if (count[byte][(from[0].num >> (8 * byte)) & 0xff] == n)
+      continue;
+
+    for (b = 0, pos[0] = 0; b < 255; b++)
+      pos[b + 1] = pos[b] + count[byte][b];
+    for (i = 0; i < n; i++)
+      to[pos[(from[i].num >> (8 * byte)) & 0xff]++] = from[i];
+
+    swap = from;
+    from = to;
+    to = swap;
+  }
+
+  if (from != keys)
+    memcpy (keys, from, n * sizeof (SORT_KEY));
+}
+
+static int sort_keys_compare (const SORT_KEY *a, const SORT_KEY *b, int reverse)
+{
+  int rc;
+
+  if (a->str && b->str)
+    rc = strcmp (a->str, b->str);
+  else if (a->str || b->str)
+    rc = a->str ? 1 : -1;
+  else
+    /* compare_subject reverses the already reversed date of two messages
+     * without a subject once more */
+    return (a->num > b->num) - (a->num < b->num);
+
+  return reverse ? -rc : rc;
+}
+
+/* stable bottom-up merge sort on the string key */
+static void sort_keys_merge (SORT_KEY *keys, SORT_KEY *tmp, int n, int reverse)
+{
+  SORT_KEY *from = keys, *to = tmp, *swap, t;
+  int width, lo, mid, hi, i, j, k, rc;
+
+  for (width = 1; width < n; width *= 2)
+  {
+    for (lo = 0; lo < n; lo += 2 * width)
+    {
+      mid = MIN (lo + width, n);
+      hi = MIN (lo + 2 * width, n);
+      for (i = lo, j = mid, k = lo; k < hi; k++)
+      {
+        if (i < mid && j < hi)
+        {
+          rc = sort_keys_compare (&from[i], &from[j], reverse);
+          to[k] = (rc <= 0) ? from[i++] : from[j++];
+        }
+        else
+          to[k] = (i < mid) ? from[i++] : from[j++];
+      }
+    }
+
+    swap = from;
+    from = to;
+    to = swap;
+  }
+
+  if (from != keys)
+    memcpy (keys, from, n * sizeof (SORT_KEY));
+
+  /* ...and for equal dates it reverses $sort_aux, too */
+  if (reverse)
+  {
+    for (i = 0; i < n; i = j)
+    {
+      for (j = i + 1; j < n && !keys[i].str && !keys[j].str &&
+             keys[i].num == keys[j].num; j++)
+        ;
+      for (lo = i, hi = j - 1; lo < hi; lo++, hi--)
+      {
+        t = keys[lo];
+        keys[lo] = keys[hi];
+        keys[hi] = t;
+      }
+    }
+  }
+}
+
+static void sort_keys_by (SORT_KEY *keys, SORT_KEY *tmp, int n, int method,
+                          BUFFER *arena)
+{
+  sort_keys_fill (keys, n, method, arena);
+  switch (method & SORT_MASK)
+  {
+    case SORT_SUBJECT:
+    case SORT_FROM:
+    case SORT_TO:
+      sort_keys_merge (keys, tmp, n, method & SORT_REVERSE);
+      break;
+    default:
+      sort_keys_radix (keys, tmp, n, method & SORT_REVERSE);
+  }
+}
+
+/* mutt_sort_keys: sorts keys[] by their headers as the compare function
+ * for sort would, breaking ties by aux.  If aux is 0, ties are broken by
+ * message index, as when $sort_aux isn't in effect.
+ * Returns -1 if either method has no precomputed keys. */
+int mutt_sort_keys (SORT_KEY *keys, int n, int sort, int aux)
+{
+  SORT_KEY *tmp;
+  BUFFER *arena;
+
+  if (!sort_has_keys (sort) || (aux && !sort_has_keys (aux)))
+    return -1;
+  if (n < 2)
+    return 0;
+
+  tmp = safe_malloc (n * sizeof (SORT_KEY));
+  arena = mutt_buffer_pool_get ();
+
+  /* least significant first: the final tie breaker is the message
+   * index, in the direction of the method breaking the tie.  The index
+   * is unique, so there is nothing left to break ties for when it is
+   * the primary key. */
+  if ((sort & SORT_MASK) == SORT_ORDER)
+    sort_keys_by (keys, tmp, n, sort, arena);
+  else
+  {
+    sort_keys_by (keys, tmp, n, SORT_ORDER | ((aux ? aux : sort) & SORT_REVERSE),
+                  arena);
+    if (aux && (aux & SORT_MASK) != SORT_ORDER)
+      sort_keys_by (keys, tmp, n, aux, arena);
+    sort_keys_by (keys, tmp, n, sort, arena);
+  }
+
+  mutt_buffer_pool_release (&arena);
+  FREE (&tmp);
+
+  return 0;
+}
+
+/* sorts ctx->hdrs by $sort and $sort_aux using precomputed keys.
+ * Returns -1 if that isn't possible for the current methods. */
+static int sort_headers_by_keys (CONTEXT *ctx)
+{
+  SORT_KEY *keys;
+  int i;
+
+  keys = safe_malloc (ctx->msgcount * sizeof (SORT_KEY));
+  for (i = 0; i < ctx->msgcount; i++)
+    keys[i].h = ctx->hdrs[i];
+
+  if (mutt_sort_keys (keys, ctx->msgcount, Sort, SortAux) < 0)
+  {
+    FREE (&keys);
+    return -1;
+  }
+
+  for (i = 0; i < ctx->msgcount; i++)
+    ctx->hdrs[i] = keys[i].h;
+  FREE (&keys);
+
+  return 0;
+}
+
 void mutt_sort_headers (CONTEXT *ctx, int init)
 {
   int i;
@@ -285,6 +564,8 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
   if (!ctx)
     return;
 
+  IndexRowGen++;
+
   if (!ctx->msgcount)
   {
     /* this function gets called by mutt_sync_mailbox(), which may have just
@@ -339,7 +620,7 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
     mutt_sleep (1);
     return;
   }
-  else
+  else if (sort_headers_by_keys (ctx) < 0)
     qsort ((void *) ctx->hdrs, ctx->msgcount, sizeof (HEADER *), sortfunc);
 
   /* adjust the virtual message numbers */
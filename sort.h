@@ -56,6 +56,18 @@
 typedef int sort_t (const void *, const void *);
 sort_t *mutt_get_sort_func (int);
 
+/* a message and its precomputed sort key, see mutt_sort_keys() */
+typedef struct
+{
+  HEADER *h;
+  void *data;			/* caller's item belonging to h */
+  const char *str;		/* case-folded string key, NULL if none */
+  size_t stroff;		/* offset of str while the keys are built */
+  unsigned long long num;	/* integer key */
+} SORT_KEY;
+
+int mutt_sort_keys (SORT_KEY *, int, int, int);
+
 void mutt_clear_threads (CONTEXT *);
 void mutt_sort_headers (CONTEXT *, int);
 void mutt_sort_threads (CONTEXT *, int);
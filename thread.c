@@ -23,6 +23,12 @@
 #include "mutt.h"
 #include "sort.h"
 #include "mailbox.h"
+#include "mx.h"
+
+#ifdef USE_HCACHE
+#include "hcache.h"
+#include "md5.h"
+#endif
 
 #include <string.h>
 #include <ctype.h>
@@ -240,6 +246,8 @@ void mutt_draw_tree (CONTEXT *ctx)
   int depth = 0, start_depth = 0, max_depth = 0, width = option (OPTNARROWTREE) ? 1 : 2;
   THREAD *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = ctx->tree;
 
+  IndexRowGen++;
+
   /* Do the visibility calculations and free the old thread chars.
    * From now on we can simply ignore invisible subtrees
    */
@@ -583,11 +591,15 @@ static int compare_threads (const void *a, const void *b)
   }
 }
 
+/* sibling lists at least this long are sorted on precomputed keys */
+#define SORT_KEYS_THRESHOLD 64
+
 THREAD *mutt_sort_subthreads (THREAD *thread, int init)
 {
   THREAD **array, *sort_key, *top, *tmp;
   HEADER *oldsort_key;
-  int i, array_size, sort_top = 0;
+  SORT_KEY *keys = NULL;
+  int i, j, array_size, sort_top = 0;
 
   /* we put things into the array backwards to save some cycles,
    * but we want to have to move less stuff around if we're
@@ -644,7 +656,25 @@ THREAD *mutt_sort_subthreads (THREAD *thread, int init)
 	  array[i] = thread;
 	}
 
-	qsort ((void *) array, i, sizeof (THREAD *), *compare_threads);
+	if (i >= SORT_KEYS_THRESHOLD)
+	{
+	  /* compare_threads() breaks ties by message index */
+	  safe_realloc (&keys, i * sizeof (SORT_KEY));
+	  for (j = 0; j < i; j++)
+	  {
+	    keys[j].h = array[j]->sort_key;
+	    keys[j].data = array[j];
+	  }
+	  if (mutt_sort_keys (keys, i, Sort, 0) == 0)
+	  {
+	    for (j = 0; j < i; j++)
+	      array[j] = (THREAD *) keys[j].data;
+	  }
+	  else
+	    qsort ((void *) array, i, sizeof (THREAD *), *compare_threads);
+	}
+	else
+	  qsort ((void *) array, i, sizeof (THREAD *), *compare_threads);
 
 	/* attach them back together.  make thread the last sibling. */
 	thread = array[0];
@@ -705,6 +735,7 @@ THREAD *mutt_sort_subthreads (THREAD *thread, int init)
       {
 	Sort ^= SORT_REVERSE;
 	FREE (&array);
+	FREE (&keys);
 	return (top);
       }
     }
@@ -745,12 +776,344 @@ static void check_subjects (CONTEXT *ctx, int init)
   }
 }
 
+#ifdef USE_HCACHE
+/* The thread cache keeps the links built by a full threading pass in the
+ * folder's header cache, so reopening an unchanged folder can skip the
+ * threading by references and subjects.  The entry is keyed by a digest
+ * of everything that pass looks at, in the order it looks at it, so any
+ * change to the folder or to the threading options just misses. */
+
+#define THREAD_CACHE_KEY      "/THREADS"
+#define THREAD_CACHE_VERSION  1
+
+/* node flags */
+#define TC_MESSAGE        (1<<0)
+#define TC_FAKE           (1<<1)
+#define TC_DUPLICATE      (1<<2)
+#define TC_SUBJECTCHANGED (1<<3)
+
+typedef struct
+{
+  unsigned int version;
+  unsigned int msgcount;
+  unsigned int nodes;
+  unsigned int size;		/* of the whole entry */
+  unsigned char digest[16];
+} THREAD_CACHE_HDR;
+
+/* each node follows in preorder as a flag byte, its depth, and either
+ * the message's index or the NUL terminated message-id of the missing
+ * message it stands for */
+
+typedef struct
+{
+  THREAD *thread;
+  const char *key;
+} THREAD_CACHE_REF;
+
+static void thread_cache_digest_str (struct md5_ctx *md5, const char *s)
+{
+  if (s)
+  {
+    md5_process_bytes ("\001", 1, md5);
+    md5_process_bytes (s, strlen (s) + 1, md5);
+  }
+  else
+    md5_process_bytes ("", 1, md5);
+}
+
+static void thread_cache_digest (CONTEXT *ctx, unsigned char *digest)
+{
+  struct md5_ctx md5;
+  HEADER *cur;
+  LIST *ref;
+  unsigned char opts[4];
+  int i;
+
+  md5_init_ctx (&md5);
+
+  opts[0] = option (OPTDUPTHREADS);
+  opts[1] = option (OPTSTRICTTHREADS);
+  opts[2] = option (OPTTHREADRECEIVED);
+  opts[3] = option (OPTSORTRE);
+  md5_process_bytes (opts, sizeof (opts), &md5);
+
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    cur = ctx->hdrs[i];
+    md5_process_bytes (&cur->index, sizeof (cur->index), &md5);
+    md5_process_bytes (&cur->date_sent, sizeof (cur->date_sent), &md5);
+    md5_process_bytes (&cur->received, sizeof (cur->received), &md5);
+    thread_cache_digest_str (&md5, cur->env->message_id);
+    for (ref = cur->env->in_reply_to; ref; ref = ref->next)
+      thread_cache_digest_str (&md5, NONULL (ref->data));
+    thread_cache_digest_str (&md5, NULL);
+    for (ref = cur->env->references; ref; ref = ref->next)
+      thread_cache_digest_str (&md5, NONULL (ref->data));
+    thread_cache_digest_str (&md5, NULL);
+    thread_cache_digest_str (&md5, cur->env->real_subj);
+    md5_process_bytes (cur->env->real_subj == cur->env->subject ? "\001" : "",
+		       1, &md5);
+  }
+
+  md5_finish_ctx (&md5, digest);
+}
+
+static int thread_cache_ref_cmp (const void *a, const void *b)
+{
+  const THREAD *ta = ((const THREAD_CACHE_REF *) a)->thread;
+  const THREAD *tb = ((const THREAD_CACHE_REF *) b)->thread;
+
+  return (ta < tb) ? -1 : (ta > tb);
+}
+
+static void thread_cache_store (CONTEXT *ctx, header_cache_t *hc,
+				const unsigned char *digest)
+{
+  THREAD_CACHE_HDR hdr;
+  THREAD_CACHE_REF *refs = NULL, *found, key;
+  struct hash_walk_state state;
+  struct hash_elem *elem;
+  THREAD *thread;
+  BUFFER *buf;
+  unsigned char flags;
+  int depth, nrefs = 0, refsmax = 0;
+
+  /* messageless containers don't know their own message-id, only the
+   * thread hash does */
+  memset (&state, 0, sizeof (state));
+  while ((elem = hash_walk (ctx->thread_hash, &state)))
+  {
+    if (((THREAD *) elem->data)->message)
+      continue;
+    if (nrefs == refsmax)
+      safe_realloc (&refs, (refsmax += 64) * sizeof (THREAD_CACHE_REF));
+    refs[nrefs].thread = elem->data;
+    refs[nrefs++].key = elem->key.strkey;
+  }
+  if (nrefs)
+    qsort (refs, nrefs, sizeof (THREAD_CACHE_REF), thread_cache_ref_cmp);
+
+  memset (&hdr, 0, sizeof (hdr));
+  hdr.version = THREAD_CACHE_VERSION;
+  hdr.msgcount = ctx->msgcount;
+  memcpy (hdr.digest, digest, sizeof (hdr.digest));
+
+  buf = mutt_buffer_new ();
+  mutt_buffer_increase_size (buf, sizeof (hdr) + ctx->msgcount * 16);
+  mutt_buffer_addstr_n (buf, (char *) &hdr, sizeof (hdr));
+
+  depth = 0;
+  thread = ctx->tree;
+  while (thread)
+  {
+    flags = 0;
+    if (thread->message)
+    {
+      flags |= TC_MESSAGE;
+      if (thread->message->subject_changed)
+	flags |= TC_SUBJECTCHANGED;
+    }
+    if (thread->fake_thread)
+      flags |= TC_FAKE;
+    if (thread->duplicate_thread)
+      flags |= TC_DUPLICATE;
+
+    mutt_buffer_addch (buf, flags);
+    mutt_buffer_addstr_n (buf, (char *) &depth, sizeof (depth));
+    if (thread->message)
+      mutt_buffer_addstr_n (buf, (char *) &thread->message->index,
+			    sizeof (thread->message->index));
+    else
+    {
+      key.thread = thread;
+      if (!(found = bsearch (&key, refs, nrefs, sizeof (THREAD_CACHE_REF),
+			     thread_cache_ref_cmp)))
+	goto cleanup;
+      mutt_buffer_addstr_n (buf, found->key, strlen (found->key) + 1);
+    }
+    hdr.nodes++;
+
+    if (thread->child)
+    {
+      thread = thread->child;
+      depth++;
+      continue;
+    }
+    while (thread && !thread->next)
+    {
+      thread = thread->parent;
+      depth--;
+    }
+    if (thread)
+      thread = thread->next;
+  }
+
+  hdr.size = mutt_buffer_len (buf);
+  memcpy (buf->data, &hdr, sizeof (hdr));
+  if (mutt_hcache_store_raw (hc, THREAD_CACHE_KEY, buf->data, hdr.size,
+			     mutt_strlen) == 0)
+    dprint (2, (debugfile, "thread_cache_store: stored %u nodes in %u bytes\n",
+		hdr.nodes, hdr.size));
+
+cleanup:
+  mutt_buffer_free (&buf);
+  FREE (&refs);
+}
+
+/* Rebuilds ctx->tree and ctx->thread_hash from the cache.  The entry is
+ * checked completely before anything is built, so on failure the
+ * context is left untouched. */
+static int thread_cache_restore (CONTEXT *ctx, header_cache_t *hc,
+				 const unsigned char *digest)
+{
+  THREAD_CACHE_HDR hdr;
+  THREAD **stack = NULL, *thread, *parent;
+  HEADER **byindex = NULL, *cur;
+  unsigned char *data, *p, *end, flags;
+  unsigned int n;
+  size_t len;
+  int i, depth, last, container, index, rc = -1;
+
+  if (!(data = mutt_hcache_fetch_raw_len (hc, THREAD_CACHE_KEY, mutt_strlen,
+					  &len)))
+    return -1;
+
+  /* don't trust the stored size, the entry may be truncated */
+  if (len < sizeof (hdr))
+    goto cleanup;
+  memcpy (&hdr, data, sizeof (hdr));
+  if (hdr.version != THREAD_CACHE_VERSION ||
+      hdr.msgcount != ctx->msgcount ||
+      hdr.size != len ||
+      memcmp (hdr.digest, digest, sizeof (hdr.digest)))
+    goto cleanup;
+
+  byindex = safe_calloc (ctx->msgcount, sizeof (HEADER *));
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    cur = ctx->hdrs[i];
+    if (cur->thread || cur->threaded || cur->index < 0 || cur->index >= ctx->msgcount ||
+	byindex[cur->index])
+      goto cleanup;
+    byindex[cur->index] = cur;
+  }
+
+  /* first pass: make sure the tree is well formed, holds every message
+   * exactly once and has no childless containers */
+  end = data + hdr.size;
+  last = -1;
+  container = 0;
+  for (n = 0, p = data + sizeof (hdr); n < hdr.nodes; n++)
+  {
+    if (p + 1 + sizeof (int) > end)
+      goto cleanup;
+    flags = *p++;
+    memcpy (&depth, p, sizeof (int));
+    p += sizeof (int);
+    if (depth < 0 || depth > last + 1 || (container && depth != last + 1))
+      goto cleanup;
+    last = depth;
+    container = !(flags & TC_MESSAGE);
+
+    if (flags & TC_MESSAGE)
+    {
+      if (p + sizeof (int) > end)
+	goto cleanup;
+      memcpy (&index, p, sizeof (int));
+      p += sizeof (int);
+      if (index < 0 || index >= ctx->msgcount || !byindex[index] ||
+	  byindex[index]->threaded)
+	goto cleanup;
+      byindex[index]->threaded = 1;
+    }
+    else
+    {
+      while (p < end && *p)
+	p++;
+      if (p++ == end)
+	goto cleanup;
+    }
+  }
+  if (p != end || container)
+    goto cleanup;
+  for (i = 0; i < ctx->msgcount; i++)
+    if (!ctx->hdrs[i]->threaded)
+      goto cleanup;
+
+  /* second pass: build it.  nodes come in preorder, so the last node
+   * seen at each depth is the previous sibling if it has the same
+   * parent */
+  ctx->thread_hash = hash_create (ctx->msgcount * 2,
+				  MUTT_HASH_ALLOW_DUPS | MUTT_HASH_STRDUP_KEYS);
+  stack = safe_calloc (hdr.nodes, sizeof (THREAD *));
+  for (n = 0, p = data + sizeof (hdr); n < hdr.nodes; n++)
+  {
+    flags = *p++;
+    memcpy (&depth, p, sizeof (int));
+    p += sizeof (int);
+
+    thread = safe_calloc (1, sizeof (THREAD));
+    thread->fake_thread = (flags & TC_FAKE) ? 1 : 0;
+    thread->duplicate_thread = (flags & TC_DUPLICATE) ? 1 : 0;
+    if (flags & TC_MESSAGE)
+    {
+      memcpy (&index, p, sizeof (int));
+      p += sizeof (int);
+      cur = byindex[index];
+      cur->thread = thread;
+      cur->subject_changed = (flags & TC_SUBJECTCHANGED) ? 1 : 0;
+      thread->message = cur;
+      hash_insert (ctx->thread_hash,
+		   cur->env->message_id ? cur->env->message_id : "", thread);
+    }
+    else
+    {
+      hash_insert (ctx->thread_hash, (char *) p, thread);
+      p += strlen ((char *) p) + 1;
+    }
+
+    parent = depth ? stack[depth - 1] : NULL;
+    thread->parent = parent;
+    if (stack[depth] && stack[depth]->parent == parent)
+    {
+      thread->prev = stack[depth];
+      stack[depth]->next = thread;
+    }
+    else if (parent)
+      parent->child = thread;
+    else
+      ctx->tree = thread;
+    stack[depth] = thread;
+  }
+
+  dprint (2, (debugfile, "thread_cache_restore: restored %u nodes\n",
+	      hdr.nodes));
+  rc = 0;
+
+cleanup:
+  if (rc)
+  {
+    for (i = 0; i < ctx->msgcount; i++)
+      ctx->hdrs[i]->threaded = 0;
+  }
+  FREE (&stack);
+  FREE (&byindex);
+  mutt_hcache_free ((void **) &data);
+  return rc;
+}
+#endif /* USE_HCACHE */
+
 void mutt_sort_threads (CONTEXT *ctx, int init)
 {
   HEADER *cur;
   int i, oldsort, using_refs = 0;
   THREAD *thread, *new, *tmp, top;
   LIST *ref = NULL;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+  unsigned char digest[16];
+#endif
 
   /* set Sort to the secondary method to support the set sort_aux=reverse-*
    * settings.  The sorting functions just look at the value of
@@ -762,6 +1125,15 @@ void mutt_sort_threads (CONTEXT *ctx, int init)
   if (!ctx->thread_hash)
     init = 1;
 
+#ifdef USE_HCACHE
+  if (init && (hc = mx_hcache_open (ctx)))
+  {
+    thread_cache_digest (ctx, digest);
+    if (thread_cache_restore (ctx, hc, digest) == 0)
+      goto subthreads;
+  }
+#endif
+
   if (init)
     ctx->thread_hash = hash_create (ctx->msgcount * 2, MUTT_HASH_ALLOW_DUPS);
 
@@ -956,6 +1328,14 @@ void mutt_sort_threads (CONTEXT *ctx, int init)
   if (!option (OPTSTRICTTHREADS))
     pseudo_threads (ctx);
 
+#ifdef USE_HCACHE
+  if (hc)
+    thread_cache_store (ctx, hc, digest);
+
+subthreads:
+  mx_hcache_close (ctx, hc);
+#endif
+
   if (ctx->tree)
   {
     ctx->tree = mutt_sort_subthreads (ctx->tree, init);
@@ -1432,6 +1812,7 @@ static void clean_references (THREAD *brk, THREAD *cur)
 
       h->changed = 1;
       h->env->changed |= MUTT_ENV_CHANGED_REFS;
+      mutt_reset_header_color (h);
     }
   }
 }
@@ -1442,6 +1823,7 @@ void mutt_break_thread (HEADER *hdr)
   mutt_free_list (&hdr->env->references);
   hdr->changed = 1;
   hdr->env->changed |= (MUTT_ENV_CHANGED_IRT | MUTT_ENV_CHANGED_REFS);
+  mutt_reset_header_color (hdr);
 
   clean_references (hdr->thread, hdr->thread->child);
 }
@@ -1460,6 +1842,8 @@ static int link_threads (HEADER *parent, HEADER *child, CONTEXT *ctx)
 
   child->changed = 1;
   child->env->changed |= MUTT_ENV_CHANGED_IRT;
+  child->gen++;
+  ctx->gen++;
   return 1;
 }
 